@@ -0,0 +1,136 @@
+#include "ChainSegmentCache.hpp"
+#include <assert.h>
+
+namespace transformer {
+
+ChainSegment::ChainSegment(ChainSegment* parent, const std::vector< TransformationEdge >& edges, bool isStatic)
+    : parent(parent)
+    , edges(edges)
+    , versions(edges.size(), 0)
+    , staticSegment(isStatic)
+    , references(0)
+    , step(Eigen::Isometry3d::Identity())
+    , value(Eigen::Isometry3d::Identity())
+    , valid(false)
+    , interpolate(false)
+    , stamp(0)
+    , parentStamp(0)
+{
+    if(staticSegment)
+        updateStaticStep();
+}
+
+bool ChainSegment::versionsChanged() const
+{
+    for(size_t i = 0; i < edges.size(); i++)
+    {
+        if(edges[i].element->getVersion() != versions[i])
+            return true;
+    }
+    return false;
+}
+
+void ChainSegment::updateStaticStep()
+{
+    std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> > poses(edges.size());
+    for(size_t i = 0; i < edges.size(); i++)
+    {
+        versions[i] = edges[i].element->getVersion();
+        //static elements do not depend on the time
+        edges[i].element->getPose(base::Time(), false, poses[i]);
+        if(edges[i].inverse)
+            poses[i] = poses[i].inverse(Eigen::Isometry);
+    }
+    CompositionTraits<Eigen::Isometry3d>::composeChain(&poses[0], poses.size(), step);
+}
+
+const Eigen::Isometry3d& ChainSegment::getStaticStep()
+{
+    assert(staticSegment);
+    if(versionsChanged())
+    {
+        updateStaticStep();
+        valid = false;
+    }
+    return step;
+}
+
+bool ChainSegment::update(const base::Time& atTime, bool interpolate)
+{
+    unsigned currentParentStamp = parent ? parent->stamp : 0;
+    bool changed = versionsChanged();
+    if(!changed && valid && parentStamp == currentParentStamp &&
+        (staticSegment || (time == atTime && this->interpolate == interpolate)))
+        return true;
+
+    valid = false;
+    if(staticSegment)
+    {
+        if(changed)
+            updateStaticStep();
+    }
+    else
+    {
+        const TransformationEdge &edge(edges.front());
+        versions.front() = edge.element->getVersion();
+        Eigen::Isometry3d pose;
+        if(!edge.element->getPose(atTime, interpolate, pose))
+            return false;
+        if(edge.inverse)
+            pose = pose.inverse(Eigen::Isometry);
+        step = pose;
+    }
+
+    if(parent)
+        CompositionTraits<Eigen::Isometry3d>::compose(parent->value, step, value);
+    else
+        value = step;
+
+    valid = true;
+    time = atTime;
+    this->interpolate = interpolate;
+    parentStamp = currentParentStamp;
+    stamp++;
+    //0 is the stamp of a missing parent
+    if(stamp == 0)
+        stamp = 1;
+    return true;
+}
+
+ChainSegmentCache::~ChainSegmentCache()
+{
+    for(std::map<Key, ChainSegment *>::iterator it = segments.begin(); it != segments.end(); it++)
+    {
+        delete it->second;
+    }
+}
+
+ChainSegmentCache::Key ChainSegmentCache::makeKey(ChainSegment* parent, const std::vector< TransformationEdge >& edges)
+{
+    Key key;
+    key.first = parent;
+    key.second.reserve(edges.size());
+    for(std::vector<TransformationEdge>::const_iterator it = edges.begin(); it != edges.end(); it++)
+        key.second.push_back(std::make_pair(it->element, it->inverse));
+    return key;
+}
+
+ChainSegment* ChainSegmentCache::acquire(ChainSegment* parent, const std::vector< TransformationEdge >& edges, bool isStatic)
+{
+    ChainSegment *&segment(segments[makeKey(parent, edges)]);
+    if(!segment)
+        segment = new ChainSegment(parent, edges, isStatic);
+    segment->references++;
+    return segment;
+}
+
+void ChainSegmentCache::release(ChainSegment* segment)
+{
+    if(--segment->references > 0)
+        return;
+
+    segments.erase(makeKey(segment->parent, segment->edges));
+    delete segment;
+}
+
+}
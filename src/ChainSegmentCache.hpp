@@ -0,0 +1,142 @@
+#ifndef TRANSFORMER_CHAIN_SEGMENT_CACHE_HPP
+#define TRANSFORMER_CHAIN_SEGMENT_CACHE_HPP
+
+#include "Transformer.hpp"
+#include <map>
+
+namespace transformer
+{
+
+/**
+ * A part of a transformation chain, as evaluated by Transformation::get.
+ *
+ * A segment is either a single non-static edge, or a sequence of
+ * consecutive static edges that gets composed once. Each segment knows the
+ * segment preceding it in the chain (its parent) and stores the composition
+ * of the chain from its beginning up to and including itself, for the last
+ * requested time.
+ *
+ * As the value only depends on the edges from the beginning of the chain,
+ * chains that start with the same edges can share their segments.
+ * */
+class ChainSegment
+{
+    public:
+	ChainSegment(ChainSegment *parent, const std::vector<TransformationEdge> &edges, bool isStatic);
+
+	/**
+	 * Brings the value of this segment up to date for the given query.
+	 * The parent must have been updated for the same query before.
+	 *
+	 * Nothing gets evaluated if neither the parent nor the elements of
+	 * this segment changed since the last update for this query. Values
+	 * of static segments do not depend on the time.
+	 *
+	 * Returns false if a sample is missing
+	 * */
+	bool update(const base::Time &atTime, bool interpolate);
+
+	/**
+	 * Returns the composition of the chain up to and including this
+	 * segment, as computed by the last successful update
+	 * */
+	const Eigen::Isometry3d &getValue() const
+	{
+	    return value;
+	}
+
+	/**
+	 * Returns the composition of the edges of a static segment
+	 * */
+	const Eigen::Isometry3d &getStaticStep();
+
+	ChainSegment *getParent() const
+	{
+	    return parent;
+	}
+
+	const std::vector<TransformationEdge> &getEdges() const
+	{
+	    return edges;
+	}
+
+	bool isStatic() const
+	{
+	    return staticSegment;
+	}
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    private:
+	friend class ChainSegmentCache;
+
+	ChainSegment *parent;
+	std::vector<TransformationEdge> edges;
+	///element versions the current step and value were computed with
+	std::vector<unsigned> versions;
+	bool staticSegment;
+	///number of chains using this segment
+	int references;
+
+	///transformation of the edges of this segment
+	Eigen::Isometry3d step;
+	Eigen::Isometry3d value;
+
+	///query value was computed for
+	bool valid;
+	base::Time time;
+	bool interpolate;
+	///incremented every time value changes. Children compare it with
+	///the one they were computed with
+	unsigned stamp;
+	unsigned parentStamp;
+
+	bool versionsChanged() const;
+	void updateStaticStep();
+};
+
+/**
+ * Hands out the segments of the chains of all the transformations of a
+ * Transformer, so that chains starting with the same edges share the
+ * evaluation of these edges. When several transformations to the same frame
+ * are queried for the same time, each shared segment gets evaluated only
+ * once.
+ *
+ * Segments are reference counted. A segment is deleted as soon as no chain
+ * uses it anymore, which must happen before any of its elements gets
+ * deleted.
+ * */
+class ChainSegmentCache
+{
+    public:
+	~ChainSegmentCache();
+
+	/**
+	 * Returns the segment made of the given edges following 'parent',
+	 * creating it if needed, and increments its reference count
+	 * */
+	ChainSegment *acquire(ChainSegment *parent, const std::vector<TransformationEdge> &edges, bool isStatic);
+
+	/**
+	 * Decrements the reference count of the segment and deletes it if it
+	 * is not used anymore
+	 * */
+	void release(ChainSegment *segment);
+
+	/**
+	 * Returns the number of distinct segments in use
+	 * */
+	size_t getSegmentCount() const
+	{
+	    return segments.size();
+	}
+
+    private:
+	typedef std::pair<ChainSegment *, std::vector< std::pair<TransformationElement *, bool> > > Key;
+	std::map<Key, ChainSegment *> segments;
+
+	static Key makeKey(ChainSegment *parent, const std::vector<TransformationEdge> &edges);
+};
+
+}
+
+#endif
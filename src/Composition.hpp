@@ -0,0 +1,249 @@
+#ifndef TRANSFORMER_COMPOSITION_HPP
+#define TRANSFORMER_COMPOSITION_HPP
+
+#include <Eigen/Geometry>
+#include <cstddef>
+
+namespace transformer
+{
+
+/**
+ * A rigid body transformation stored as a unit quaternion and a
+ * translation.
+ *
+ * It can be used as the result type of Transformation::get.
+ * */
+struct QuaternionTransform
+{
+    Eigen::Quaterniond orientation;
+    Eigen::Vector3d translation;
+
+    QuaternionTransform()
+	: orientation(Eigen::Quaterniond::Identity()), translation(Eigen::Vector3d::Zero()) {}
+
+    QuaternionTransform(const Eigen::Quaterniond &orientation, const Eigen::Vector3d &translation)
+	: orientation(orientation), translation(translation) {}
+
+    /**
+     * Converts a rigid body transformation. The linear part must be a
+     * rotation.
+     * */
+    template<int Mode, int Options>
+    QuaternionTransform(const Eigen::Transform<double, 3, Mode, Options> &transform)
+	: orientation(Eigen::Matrix3d(transform.linear())), translation(transform.translation()) {}
+
+    static QuaternionTransform Identity()
+    {
+	return QuaternionTransform();
+    }
+
+    QuaternionTransform operator*(const QuaternionTransform &other) const
+    {
+	return QuaternionTransform(orientation * other.orientation, orientation * other.translation + translation);
+    }
+
+    QuaternionTransform inverse() const
+    {
+	Eigen::Quaterniond inv(orientation.conjugate());
+	return QuaternionTransform(inv, -(inv * translation));
+    }
+
+    Eigen::Isometry3d toIsometry() const
+    {
+	Eigen::Isometry3d result;
+	result.linear() = orientation.toRotationMatrix();
+	result.translation() = translation;
+	result.makeAffine();
+	return result;
+    }
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/**
+ * A rigid body transformation stored as a unit dual quaternion
+ * real + e * dual, with dual = 0.5 * translation * real.
+ *
+ * It can be used as the result type of Transformation::get.
+ * */
+struct DualQuaternion
+{
+    Eigen::Quaterniond real;
+    Eigen::Quaterniond dual;
+
+    DualQuaternion()
+	: real(Eigen::Quaterniond::Identity()), dual(0, 0, 0, 0) {}
+
+    DualQuaternion(const Eigen::Quaterniond &real, const Eigen::Quaterniond &dual)
+	: real(real), dual(dual) {}
+
+    /**
+     * Converts a rigid body transformation. The linear part must be a
+     * rotation.
+     * */
+    template<int Mode, int Options>
+    DualQuaternion(const Eigen::Transform<double, 3, Mode, Options> &transform)
+	: real(Eigen::Matrix3d(transform.linear()))
+    {
+	setTranslation(transform.translation());
+    }
+
+    static DualQuaternion Identity()
+    {
+	return DualQuaternion();
+    }
+
+    void setTranslation(const Eigen::Vector3d &translation)
+    {
+	Eigen::Quaterniond t(0, translation.x(), translation.y(), translation.z());
+	dual.coeffs() = 0.5 * (t * real).coeffs();
+    }
+
+    Eigen::Vector3d getTranslation() const
+    {
+	return 2.0 * (dual * real.conjugate()).vec();
+    }
+
+    DualQuaternion operator*(const DualQuaternion &other) const
+    {
+	Eigen::Quaterniond resultDual;
+	resultDual.coeffs() = (real * other.dual).coeffs() + (dual * other.real).coeffs();
+	return DualQuaternion(real * other.real, resultDual);
+    }
+
+    DualQuaternion inverse() const
+    {
+	return DualQuaternion(real.conjugate(), dual.conjugate());
+    }
+
+    Eigen::Isometry3d toIsometry() const
+    {
+	Eigen::Isometry3d result;
+	result.linear() = real.toRotationMatrix();
+	result.translation() = getTranslation();
+	result.makeAffine();
+	return result;
+    }
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/**
+ * Composition of transformations of type T, used by Transformation::get.
+ *
+ * The generic version uses the multiplication operator of T. The
+ * specializations make use of the rigid structure of the transformation.
+ * */
+template<class T>
+struct CompositionTraits
+{
+    /**
+     * result = a * b. result may not alias a or b
+     * */
+    static void compose(const T &a, const T &b, T &result)
+    {
+	result = a * b;
+    }
+
+    /**
+     * Composes count transformations in order, i.e. result =
+     * transforms[0] * ... * transforms[count - 1]
+     * */
+    static void composeChain(const T *transforms, size_t count, T &result)
+    {
+	result = T::Identity();
+	for(size_t i = 0; i < count; i++)
+	    result = result * transforms[i];
+    }
+};
+
+/**
+ * Composition of isometries. Single compositions work on the 3x3 rotation
+ * and the translation only.
+ * */
+template<>
+struct CompositionTraits<Eigen::Isometry3d>
+{
+    static void compose(const Eigen::Isometry3d &a, const Eigen::Isometry3d &b, Eigen::Isometry3d &result)
+    {
+	result.linear().noalias() = a.linear() * b.linear();
+	result.translation().noalias() = a.linear() * b.translation();
+	result.translation() += a.translation();
+	result.makeAffine();
+    }
+
+    /**
+     * Accumulates the chain in a plain 4x4 matrix. The 3x3 blocks used by
+     * compose are strided inside the 4x4 storage, while full 4x4 products
+     * are vectorized by Eigen. As the last row of all factors is (0 0 0 1),
+     * the result stays rigid.
+     * */
+    static void composeChain(const Eigen::Isometry3d *transforms, size_t count, Eigen::Isometry3d &result)
+    {
+	Eigen::Matrix4d acc(Eigen::Matrix4d::Identity());
+	Eigen::Matrix4d tmp;
+	for(size_t i = 0; i < count; i++)
+	{
+	    tmp.noalias() = acc * transforms[i].matrix();
+	    acc = tmp;
+	}
+	result.matrix() = acc;
+    }
+};
+
+/**
+ * Composition of unit quaternions and translations. It takes fewer
+ * operations than the product of the rotation matrices.
+ * */
+template<>
+struct CompositionTraits<QuaternionTransform>
+{
+    static void compose(const QuaternionTransform &a, const QuaternionTransform &b, QuaternionTransform &result)
+    {
+	result.translation = a.orientation * b.translation + a.translation;
+	result.orientation = a.orientation * b.orientation;
+    }
+
+    static void composeChain(const QuaternionTransform *transforms, size_t count, QuaternionTransform &result)
+    {
+	Eigen::Quaterniond orientation(Eigen::Quaterniond::Identity());
+	Eigen::Vector3d translation(Eigen::Vector3d::Zero());
+	for(size_t i = 0; i < count; i++)
+	{
+	    translation += orientation * transforms[i].translation;
+	    orientation = orientation * transforms[i].orientation;
+	}
+	result.orientation = orientation;
+	result.translation = translation;
+    }
+};
+
+/**
+ * Composition of unit dual quaternions, i.e. three quaternion products per
+ * composition.
+ * */
+template<>
+struct CompositionTraits<DualQuaternion>
+{
+    static void compose(const DualQuaternion &a, const DualQuaternion &b, DualQuaternion &result)
+    {
+	result.dual.coeffs() = (a.real * b.dual).coeffs() + (a.dual * b.real).coeffs();
+	result.real = a.real * b.real;
+    }
+
+    static void composeChain(const DualQuaternion *transforms, size_t count, DualQuaternion &result)
+    {
+	DualQuaternion acc;
+	DualQuaternion tmp;
+	for(size_t i = 0; i < count; i++)
+	{
+	    compose(acc, transforms[i], tmp);
+	    acc = tmp;
+	}
+	result = acc;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef TRANSFORMER_COVARIANCE_PROPAGATION_HPP
+#define TRANSFORMER_COVARIANCE_PROPAGATION_HPP
+
+#include <Eigen/Geometry>
+#include <base/samples/rigid_body_state.h>
+
+namespace transformer
+{
+
+/**
+ * Covariance of a rigid body transformation, on the tangent vector
+ * (translation, rotation). The perturbation is applied on the target side,
+ * i.e. the uncertain transformation is exp(e) * T, with e expressed in the
+ * target frame.
+ * */
+typedef Eigen::Matrix<double, 6, 6> PoseCovariance;
+
+/**
+ * Computes the adjoint of 'pose' on (translation, rotation) tangent
+ * vectors
+ * */
+inline void poseAdjoint(const Eigen::Isometry3d &pose, PoseCovariance &adjoint)
+{
+    const Eigen::Vector3d &t(pose.translation());
+    Eigen::Matrix3d skew;
+    skew << 0, -t.z(), t.y(),
+	t.z(), 0, -t.x(),
+	-t.y(), t.x(), 0;
+
+    adjoint.topLeftCorner<3, 3>() = pose.linear();
+    adjoint.topRightCorner<3, 3>().noalias() = skew * pose.linear();
+    adjoint.bottomLeftCorner<3, 3>().setZero();
+    adjoint.bottomRightCorner<3, 3>() = pose.linear();
+}
+
+/**
+ * First order propagation of the uncertainty of a composition:
+ *
+ *   result = a * b
+ *   resultCov = covA + Ad(a) * covB * Ad(a)^T
+ *
+ * The results may not alias the inputs.
+ * */
+inline void composeWithCovariance(const Eigen::Isometry3d &a, const PoseCovariance &covA,
+	const Eigen::Isometry3d &b, const PoseCovariance &covB,
+	Eigen::Isometry3d &result, PoseCovariance &resultCov)
+{
+    PoseCovariance adjoint;
+    poseAdjoint(a, adjoint);
+    PoseCovariance tmp;
+    tmp.noalias() = adjoint * covB;
+    resultCov.noalias() = tmp * adjoint.transpose();
+    resultCov += covA;
+    result = a * b;
+}
+
+/**
+ * Inverts a transformation and its covariance in place. The covariance of
+ * the inverse is Ad(pose^-1) * cov * Ad(pose^-1)^T
+ * */
+inline void invertWithCovariance(Eigen::Isometry3d &pose, PoseCovariance &cov)
+{
+    pose = pose.inverse(Eigen::Isometry);
+    PoseCovariance adjoint;
+    poseAdjoint(pose, adjoint);
+    PoseCovariance tmp;
+    tmp.noalias() = adjoint * cov;
+    cov.noalias() = tmp * adjoint.transpose();
+}
+
+/**
+ * Builds the covariance of a RigidBodyState from its position and
+ * orientation covariances. The cross terms are zero.
+ * */
+inline void toPoseCovariance(const base::samples::RigidBodyState &rbs, PoseCovariance &cov)
+{
+    cov.setZero();
+    cov.topLeftCorner<3, 3>() = rbs.cov_position;
+    cov.bottomRightCorner<3, 3>() = rbs.cov_orientation;
+}
+
+/**
+ * Sets the position and orientation covariances of a RigidBodyState. The
+ * cross terms get dropped.
+ * */
+inline void fromPoseCovariance(const PoseCovariance &cov, base::samples::RigidBodyState &rbs)
+{
+    rbs.cov_position = cov.topLeftCorner<3, 3>();
+    rbs.cov_orientation = cov.bottomRightCorner<3, 3>();
+}
+
+}
+
+#endif
@@ -0,0 +1,577 @@
+#ifndef TRANSFORMER_FRAME_GRAPH_HPP
+#define TRANSFORMER_FRAME_GRAPH_HPP
+
+#include "Transformer.hpp"
+#include <boost/mpl/assert.hpp>
+#include <boost/mpl/begin_end.hpp>
+#include <boost/mpl/bool.hpp>
+#include <boost/mpl/count_if.hpp>
+#include <boost/mpl/deref.hpp>
+#include <boost/mpl/distance.hpp>
+#include <boost/mpl/find.hpp>
+#include <boost/mpl/find_if.hpp>
+#include <boost/mpl/for_each.hpp>
+#include <boost/mpl/size.hpp>
+#include <boost/mpl/vector.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/is_same.hpp>
+
+/**
+ * Compile-time frame graphs for kinematic structures that are known at build
+ * time.
+ *
+ * Frames are types, declared with TRANSFORMER_FRAME. Edges are
+ * StaticFrameEdge and DynamicFrameEdge types, going from a frame to its
+ * parent. A FrameGraph is declared on a boost::mpl sequence of edges, e.g.
+ *
+ *   TRANSFORMER_FRAME(Body, "body");
+ *   TRANSFORMER_FRAME(Head, "head");
+ *   TRANSFORMER_FRAME(Camera, "camera");
+ *   typedef DynamicFrameEdge<Head, Body> HeadToBody;
+ *   typedef StaticFrameEdge<Camera, Head> CameraToHead;
+ *   typedef FrameGraph< boost::mpl::vector<HeadToBody, CameraToHead> > Robot;
+ *
+ * The edges must form a forest, i.e. every frame is the source of at most
+ * one edge and there are no cycles, which is checked at compile time. The
+ * chain between two frames is then resolved by the compiler,
+ * and FrameGraph::get composes it with inlined code, without any lookup or
+ * virtual call.
+ *
+ * The graph only holds the current value of each edge. FrameGraphBridge
+ * exposes it to a Transformer.
+ * */
+
+namespace transformer
+{
+
+/**
+ * Declares a frame type of the given name
+ * */
+#define TRANSFORMER_FRAME(Type, frameName) \
+    struct Type \
+    { \
+	static const char *name() \
+	{ \
+	    return frameName; \
+	} \
+    }
+
+/**
+ * An edge whose value is set once, e.g. the mounting of a sensor
+ * */
+template<class SourceFrame, class TargetFrame>
+struct StaticFrameEdge
+{
+    typedef SourceFrame Source;
+    typedef TargetFrame Target;
+    static const bool isStatic = true;
+};
+
+/**
+ * An edge whose value changes while running, e.g. a joint
+ * */
+template<class SourceFrame, class TargetFrame>
+struct DynamicFrameEdge
+{
+    typedef SourceFrame Source;
+    typedef TargetFrame Target;
+    static const bool isStatic = false;
+};
+
+namespace frame_graph
+{
+
+/**
+ * The parent of a root frame
+ * */
+struct NoFrame
+{
+};
+
+template<class Frame>
+struct SourceIs
+{
+    template<class Edge>
+    struct apply : boost::is_same<typename Edge::Source, Frame>
+    {
+    };
+};
+
+template<class Edges, class Frame>
+struct FindParentEdge
+{
+    typedef typename boost::mpl::find_if<Edges, SourceIs<Frame> >::type iterator;
+    static const bool isRoot = boost::is_same<iterator, typename boost::mpl::end<Edges>::type>::value;
+};
+
+/**
+ * True if Frame is a root, or if its root is at most 'steps' edges away.
+ * Only used to check the graph, as it also terminates on cycles.
+ * */
+template<class Edges, class Frame, int steps, bool isRoot = FindParentEdge<Edges, Frame>::isRoot>
+struct ReachesRoot
+{
+    typedef typename boost::mpl::deref<typename FindParentEdge<Edges, Frame>::iterator>::type Edge;
+    static const bool value = ReachesRoot<Edges, typename Edge::Target, steps - 1>::value;
+};
+
+template<class Edges, class Frame, int steps>
+struct ReachesRoot<Edges, Frame, steps, true>
+{
+    static const bool value = true;
+};
+
+template<class Edges, class Frame>
+struct ReachesRoot<Edges, Frame, 0, true>
+{
+    static const bool value = true;
+};
+
+template<class Edges, class Frame>
+struct ReachesRoot<Edges, Frame, 0, false>
+{
+    static const bool value = false;
+};
+
+/**
+ * Edge predicate, true if another edge has the same source
+ * */
+template<class Edges>
+struct SharesSource
+{
+    template<class Edge>
+    struct apply : boost::mpl::bool_<(boost::mpl::count_if<Edges, SourceIs<typename Edge::Source> >::value > 1)>
+    {
+    };
+};
+
+/**
+ * Edge predicate, true if the edge is part of a cycle or leads to one
+ * */
+template<class Edges>
+struct InCycle
+{
+    template<class Edge>
+    struct apply : boost::mpl::bool_<!ReachesRoot<Edges, typename Edge::Source, boost::mpl::size<Edges>::value>::value>
+    {
+    };
+};
+
+/**
+ * True if no edge of the sequence matches the predicate
+ * */
+template<class Edges, class Predicate>
+struct NoEdge : boost::is_same<typename boost::mpl::find_if<Edges, Predicate>::type, typename boost::mpl::end<Edges>::type>
+{
+};
+
+/**
+ * Position of a frame in the graph: its parent, the index of the edge
+ * leading to it, its depth, its root and whether all edges between the frame
+ * and the root are static.
+ * */
+template<class Edges, class Frame, bool isRoot = FindParentEdge<Edges, Frame>::isRoot>
+struct FrameInfo
+{
+    typedef typename FindParentEdge<Edges, Frame>::iterator iterator;
+    typedef typename boost::mpl::deref<iterator>::type Edge;
+    typedef typename Edge::Target Parent;
+    typedef FrameInfo<Edges, Parent> ParentInfo;
+    typedef typename ParentInfo::Root Root;
+
+    static const int index = boost::mpl::distance<typename boost::mpl::begin<Edges>::type, iterator>::value;
+    static const int depth = ParentInfo::depth + 1;
+    static const bool staticPath = Edge::isStatic && ParentInfo::staticPath;
+};
+
+template<class Edges, class Frame>
+struct FrameInfo<Edges, Frame, true>
+{
+    typedef NoFrame Parent;
+    typedef Frame Root;
+
+    static const int depth = 0;
+    static const bool staticPath = true;
+};
+
+/**
+ * The closest common ancestor of A and B, or NoFrame if they are not
+ * connected
+ * */
+template<class Edges, class A, class B,
+    int step = (boost::is_same<A, B>::value ? 0 :
+	(FrameInfo<Edges, A>::depth > FrameInfo<Edges, B>::depth) ? 1 :
+	(FrameInfo<Edges, A>::depth < FrameInfo<Edges, B>::depth) ? 2 : 3)>
+struct CommonAncestor
+{
+    typedef A type;
+};
+
+template<class Edges, class A, class B>
+struct CommonAncestor<Edges, A, B, 1>
+{
+    typedef typename CommonAncestor<Edges, typename FrameInfo<Edges, A>::Parent, B>::type type;
+};
+
+template<class Edges, class A, class B>
+struct CommonAncestor<Edges, A, B, 2>
+{
+    typedef typename CommonAncestor<Edges, A, typename FrameInfo<Edges, B>::Parent>::type type;
+};
+
+template<class Edges, class A, class B>
+struct CommonAncestor<Edges, A, B, 3>
+{
+    typedef typename CommonAncestor<Edges, typename FrameInfo<Edges, A>::Parent, typename FrameInfo<Edges, B>::Parent>::type type;
+};
+
+/**
+ * Composition of the edges from Frame up to Ancestor
+ * */
+template<class Graph, class Frame, class Ancestor, bool done = boost::is_same<Frame, Ancestor>::value>
+struct PathToAncestor
+{
+    typedef FrameInfo<typename Graph::Edges, Frame> Info;
+
+    /**
+     * result = transformation from Frame to Ancestor
+     * */
+    static void compose(const Graph &graph, Eigen::Isometry3d &result)
+    {
+	PathToAncestor<Graph, typename Info::Parent, Ancestor>::composeWith(graph, graph.poses[Info::index], result);
+    }
+
+    /**
+     * result = (transformation from Frame to Ancestor) * right
+     * */
+    static void composeWith(const Graph &graph, const Eigen::Isometry3d &right, Eigen::Isometry3d &result)
+    {
+	Eigen::Isometry3d composed;
+	CompositionTraits<Eigen::Isometry3d>::compose(graph.poses[Info::index], right, composed);
+	PathToAncestor<Graph, typename Info::Parent, Ancestor>::composeWith(graph, composed, result);
+    }
+};
+
+template<class Graph, class Frame, class Ancestor>
+struct PathToAncestor<Graph, Frame, Ancestor, true>
+{
+    static void compose(const Graph &graph, Eigen::Isometry3d &result)
+    {
+	result.setIdentity();
+    }
+
+    static void composeWith(const Graph &graph, const Eigen::Isometry3d &right, Eigen::Isometry3d &result)
+    {
+	result = right;
+    }
+};
+
+/**
+ * Composition of the chain from Source to Target, through their common
+ * ancestor
+ * */
+template<class Graph, class Source, class Target,
+    class Ancestor = typename CommonAncestor<typename Graph::Edges, Source, Target>::type,
+    bool targetIsAncestor = boost::is_same<Target, Ancestor>::value>
+struct Chain
+{
+    BOOST_MPL_ASSERT_MSG((!boost::is_same<Ancestor, NoFrame>::value), FRAMES_ARE_NOT_CONNECTED, (Source, Target));
+
+    static void compose(const Graph &graph, Eigen::Isometry3d &result)
+    {
+	Eigen::Isometry3d targetPose;
+	Eigen::Isometry3d sourcePose;
+	PathToAncestor<Graph, Target, Ancestor>::compose(graph, targetPose);
+	PathToAncestor<Graph, Source, Ancestor>::compose(graph, sourcePose);
+	CompositionTraits<Eigen::Isometry3d>::compose(targetPose.inverse(Eigen::Isometry), sourcePose, result);
+    }
+};
+
+template<class Graph, class Source, class Target, class Ancestor>
+struct Chain<Graph, Source, Target, Ancestor, true>
+{
+    static void compose(const Graph &graph, Eigen::Isometry3d &result)
+    {
+	PathToAncestor<Graph, Source, Target>::compose(graph, result);
+    }
+};
+
+}
+
+/**
+ * A graph of frames whose structure is fixed at compile time, see above.
+ *
+ * @param EdgeSequence a boost::mpl sequence of StaticFrameEdge and
+ *   DynamicFrameEdge types
+ * */
+template<class EdgeSequence>
+class FrameGraph
+{
+    template<class Graph, class Frame, class Ancestor, bool done> friend struct frame_graph::PathToAncestor;
+
+    public:
+	typedef EdgeSequence Edges;
+	static const int edgeCount = boost::mpl::size<Edges>::value;
+	BOOST_STATIC_ASSERT(edgeCount > 0);
+	BOOST_MPL_ASSERT_MSG((frame_graph::NoEdge<Edges, frame_graph::SharesSource<Edges> >::value),
+		A_FRAME_IS_THE_SOURCE_OF_SEVERAL_EDGES, (Edges));
+	BOOST_MPL_ASSERT_MSG((frame_graph::NoEdge<Edges, frame_graph::InCycle<Edges> >::value),
+		THE_EDGES_FORM_A_CYCLE, (Edges));
+
+	/**
+	 * Creates the graph with all edges set to identity
+	 * */
+	FrameGraph() : version(0), staticVersion(0)
+	{
+	    for(int i = 0; i < edgeCount; i++)
+		poses[i].setIdentity();
+	}
+
+	/**
+	 * Sets the value of an edge, i.e. the transformation from its source
+	 * to its target frame
+	 * */
+	template<class Edge>
+	void set(const Eigen::Isometry3d &pose)
+	{
+	    poses[edgeIndex<Edge>()] = pose;
+	    version++;
+	    if(Edge::isStatic)
+		staticVersion++;
+	}
+
+	template<class Edge>
+	void set(const TransformationType &tr)
+	{
+	    Eigen::Isometry3d pose;
+	    toPose(tr, pose);
+	    set<Edge>(pose);
+	}
+
+	/**
+	 * Returns the value of an edge
+	 * */
+	template<class Edge>
+	const Eigen::Isometry3d &getEdge() const
+	{
+	    return poses[edgeIndex<Edge>()];
+	}
+
+	/**
+	 * Computes the transformation from Source to Target. Fails to
+	 * compile if the frames are not connected.
+	 * */
+	template<class Source, class Target>
+	void get(Eigen::Isometry3d &result) const
+	{
+	    frame_graph::Chain<FrameGraph, Source, Target>::compose(*this, result);
+	}
+
+	/**
+	 * Returns a counter that gets incremented every time an edge is set
+	 * */
+	unsigned getVersion() const
+	{
+	    return version;
+	}
+
+	/**
+	 * Returns a counter that gets incremented every time a static edge
+	 * is set
+	 * */
+	unsigned getStaticVersion() const
+	{
+	    return staticVersion;
+	}
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    private:
+	template<class Edge>
+	static int edgeIndex()
+	{
+	    typedef typename boost::mpl::find<Edges, Edge>::type iterator;
+	    BOOST_STATIC_ASSERT((!boost::is_same<iterator, typename boost::mpl::end<Edges>::type>::value));
+	    return boost::mpl::distance<typename boost::mpl::begin<Edges>::type, iterator>::value;
+	}
+
+	Eigen::Isometry3d poses[edgeCount];
+	unsigned version;
+	unsigned staticVersion;
+};
+
+/**
+ * Base class of the elements created by FrameGraphBridge
+ * */
+class FrameGraphElementBase : public TransformationElement
+{
+    public:
+	FrameGraphElementBase(const std::string &sourceFrame, const std::string &targetFrame) : TransformationElement(sourceFrame, targetFrame) {};
+
+	/**
+	 * Calls the registered callbacks, to be called when the graph
+	 * changed
+	 * */
+	void graphChanged(const base::Time &ts)
+	{
+	    notifyTransformationChanged(ts);
+	}
+};
+
+/**
+ * The transformation from Frame to the root of its tree in a FrameGraph.
+ *
+ * The graph only holds current values, so the element returns them for all
+ * times, with or without interpolation.
+ * */
+template<class Graph, class Frame>
+class FrameGraphElement : public FrameGraphElementBase
+{
+    public:
+	typedef typename frame_graph::FrameInfo<typename Graph::Edges, Frame>::Root Root;
+
+	FrameGraphElement(const Graph &graph) : FrameGraphElementBase(Frame::name(), Root::name()), graph(graph) {};
+
+	virtual bool getTransformation(const base::Time& atTime, bool doInterpolation, TransformationType& tr)
+	{
+	    Eigen::Isometry3d pose;
+	    getPose(atTime, doInterpolation, pose);
+	    tr.initSane();
+	    tr.sourceFrame = getSourceFrame();
+	    tr.targetFrame = getTargetFrame();
+	    tr.time = atTime;
+	    tr.position = pose.translation();
+	    tr.orientation = Eigen::Quaterniond(pose.linear());
+	    return true;
+	}
+
+	virtual bool getPose(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose)
+	{
+	    graph.template get<Frame, Root>(pose);
+	    return true;
+	}
+
+    private:
+	const Graph &graph;
+};
+
+/**
+ * Exposes a FrameGraph to a Transformer, as one transformation from each
+ * frame to the root of its tree.
+ *
+ * Frames whose chain to the root is static are pushed as static
+ * transformations, so that the transformer folds them. The other ones are
+ * added as FrameGraphElement objects. Chains between any two frames of the
+ * graph are therefore at most two elements long.
+ *
+ * The elements are owned by the transformer, the bridge has to be recreated
+ * after Transformer::clear().
+ * */
+template<class Graph>
+class FrameGraphBridge
+{
+    public:
+	/**
+	 * Adds the frames of the graph to the transformer. The bridge and
+	 * the elements keep references to the graph and the transformer: the
+	 * transformer must outlive the bridge, and the graph must outlive both
+	 * the bridge and the elements, i.e. until the transformer is cleared
+	 * or destroyed.
+	 * */
+	FrameGraphBridge(const Graph &graph, Transformer &transformer) : graph(graph), transformer(transformer), staticVersion(graph.getStaticVersion())
+	{
+	    transformer.beginTopologyUpdate();
+	    boost::mpl::for_each<typename Graph::Edges>(FrameVisitor(*this, false, base::Time()));
+	    transformer.commitTopologyUpdate();
+	}
+
+	/**
+	 * Propagates the changes of the graph to the transformer. To be
+	 * called after setting edges of the graph.
+	 *
+	 * @param ts the time of the changes
+	 * */
+	void update(const base::Time &ts)
+	{
+	    if(graph.getStaticVersion() != staticVersion)
+	    {
+		staticVersion = graph.getStaticVersion();
+		boost::mpl::for_each<typename Graph::Edges>(FrameVisitor(*this, true, ts));
+	    }
+
+	    for(std::vector<FrameGraphElementBase *>::iterator it = elements.begin(); it != elements.end(); it++)
+		(*it)->graphChanged(ts);
+	}
+
+    private:
+	/**
+	 * Called for the source frame of every edge of the graph
+	 * */
+	struct FrameVisitor
+	{
+	    FrameVisitor(FrameGraphBridge &bridge, bool update, const base::Time &ts) : bridge(bridge), update(update), ts(ts) {};
+
+	    template<class Edge>
+	    void operator()(Edge) const
+	    {
+		typedef typename Edge::Source Frame;
+		visitFrame<Frame>(boost::mpl::bool_<frame_graph::FrameInfo<typename Graph::Edges, Frame>::staticPath>());
+	    }
+
+	    /**
+	     * Static frames are pushed again on every update
+	     * */
+	    template<class Frame>
+	    void visitFrame(boost::mpl::true_) const
+	    {
+		bridge.template pushStaticFrame<Frame>(ts);
+	    }
+
+	    /**
+	     * Elements of dynamic frames are only created once
+	     * */
+	    template<class Frame>
+	    void visitFrame(boost::mpl::false_) const
+	    {
+		if(!update)
+		    bridge.template addFrameElement<Frame>();
+	    }
+
+	    FrameGraphBridge &bridge;
+	    bool update;
+	    base::Time ts;
+	};
+
+	template<class Frame>
+	void pushStaticFrame(const base::Time &ts)
+	{
+	    typedef typename frame_graph::FrameInfo<typename Graph::Edges, Frame>::Root Root;
+
+	    Eigen::Isometry3d pose;
+	    graph.template get<Frame, Root>(pose);
+	    TransformationType tr;
+	    tr.initSane();
+	    tr.sourceFrame = Frame::name();
+	    tr.targetFrame = Root::name();
+	    tr.time = ts;
+	    tr.position = pose.translation();
+	    tr.orientation = Eigen::Quaterniond(pose.linear());
+	    transformer.pushStaticTransformation(tr);
+	}
+
+	template<class Frame>
+	void addFrameElement()
+	{
+	    FrameGraphElementBase *element = new FrameGraphElement<Graph, Frame>(graph);
+	    elements.push_back(element);
+	    transformer.pushTransformationElement(element);
+	}
+
+	const Graph &graph;
+	Transformer &transformer;
+	unsigned staticVersion;
+	std::vector<FrameGraphElementBase *> elements;
+};
+
+}
+
+#endif
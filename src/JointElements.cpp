@@ -0,0 +1,204 @@
+#include "JointElements.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace transformer {
+
+bool JointTransformationElement::getTransformation(const base::Time& atTime, bool doInterpolation, TransformationType& tr)
+{
+    Eigen::Isometry3d pose;
+    if(!getPose(atTime, doInterpolation, pose))
+        return false;
+
+    tr.initSane();
+    tr.sourceFrame = getSourceFrame();
+    tr.targetFrame = getTargetFrame();
+    tr.time = atTime;
+    tr.position = pose.translation();
+    tr.orientation = Eigen::Quaterniond(pose.linear());
+    return true;
+}
+
+bool JointTransformationElement::getPose(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose)
+{
+    return stream.getJointPose(index, atTime, doInterpolation, pose);
+}
+
+bool JointTransformationElement::getSampleTimeAfter(const base::Time& time, base::Time& sampleTime) const
+{
+    return stream.getSampleTimeAfter(time, sampleTime);
+}
+
+JointStateStream::JointStateStream(const std::vector< JointDescription >& joints, aggregator::StreamAligner* aggregator, int priority, const std::string& name, size_t historySize)
+    : aggregator(aggregator)
+    , streamIdx(-1)
+    , historySize(std::max<size_t>(historySize, 1))
+    , sampleVersion(0)
+    , cacheValid(false)
+{
+    for(size_t i = 0; i < joints.size(); i++)
+    {
+        const JointDescription &joint(joints[i]);
+        if(joint.sourceFrame == "" || joint.targetFrame == "")
+            throw std::runtime_error("Joint " + joint.name + " with empty target or source frame given");
+
+        jointNames.push_back(joint.name);
+        if(joint.type == JointDescription::REVOLUTE)
+            elements.push_back(new RevoluteJointElement(joint, *this, i));
+        else
+            elements.push_back(new PrismaticJointElement(joint, *this, i));
+    }
+    poses.resize(joints.size());
+    validPoses.resize(joints.size());
+
+    if(aggregator)
+    {
+        streamIdx = aggregator->registerStream<base::samples::Joints>(
+                boost::bind( &transformer::JointStateStream::setJoints, this, _1, _2 ),
+                0, base::Time(), priority, name);
+    }
+}
+
+JointStateStream::~JointStateStream()
+{
+    if(aggregator)
+        aggregator->unregisterStream(streamIdx);
+}
+
+void JointStateStream::getPositions(const base::samples::Joints& joints, std::vector< double >& positions)
+{
+    //samples of a stream usually carry the same names in the same order,
+    //so the name lookup is only redone when they change
+    if(joints.names != sampleNames)
+    {
+        sampleNames = joints.names;
+        sampleIndices.resize(jointNames.size());
+        for(size_t i = 0; i < jointNames.size(); i++)
+        {
+            std::vector<std::string>::const_iterator it = std::find(sampleNames.begin(), sampleNames.end(), jointNames[i]);
+            sampleIndices[i] = it - sampleNames.begin();
+        }
+    }
+
+    positions.resize(jointNames.size());
+    for(size_t i = 0; i < jointNames.size(); i++)
+    {
+        size_t idx = sampleIndices[i];
+        if(idx < joints.elements.size() && joints.elements[idx].hasPosition())
+            positions[i] = joints.elements[idx].position;
+        else
+            positions[i] = std::numeric_limits<double>::quiet_NaN();
+    }
+}
+
+void JointStateStream::setHistorySize(size_t size)
+{
+    historySize = std::max<size_t>(size, 1);
+    while(sampleTimes.size() > historySize)
+    {
+        sampleTimes.pop_front();
+        samplePositions.pop_front();
+    }
+}
+
+void JointStateStream::setJoints(const base::Time& ts, const base::samples::Joints& joints)
+{
+    //samples usually arrive in time order, i.e. get appended
+    std::deque<base::Time>::iterator it = std::lower_bound(sampleTimes.begin(), sampleTimes.end(), ts);
+    size_t index = it - sampleTimes.begin();
+    if(it == sampleTimes.end() || *it != ts)
+    {
+        if(index == 0 && sampleTimes.size() >= historySize)
+            return;
+
+        sampleTimes.insert(it, ts);
+        samplePositions.insert(samplePositions.begin() + index, std::vector<double>());
+        if(sampleTimes.size() > historySize)
+        {
+            sampleTimes.pop_front();
+            samplePositions.pop_front();
+            index--;
+        }
+    }
+    getPositions(joints, samplePositions[index]);
+    sampleVersion++;
+
+    for(std::vector<JointTransformationElement *>::iterator it = elements.begin(); it != elements.end(); it++)
+        (*it)->jointsChanged(ts);
+}
+
+bool JointStateStream::update(const base::Time& atTime, bool doInterpolation)
+{
+    if(cacheValid && cachedVersion == sampleVersion && cachedTime == atTime && cachedInterpolation == doInterpolation)
+        return true;
+
+    //failed queries are not cached, as the next sample may arrive in the
+    //aggregator without changing the current one
+    cacheValid = false;
+    if(sampleTimes.empty())
+        return false;
+
+    //index of the first sample after the query
+    size_t index = std::upper_bound(sampleTimes.begin(), sampleTimes.end(), atTime) - sampleTimes.begin();
+    if(index == 0)
+        return false;
+
+    const base::Time &startTime(sampleTimes[index - 1]);
+    if(!doInterpolation || startTime == atTime)
+        positions = samplePositions[index - 1];
+    else if(index < sampleTimes.size())
+        interpolate(atTime, startTime, samplePositions[index - 1], sampleTimes[index], samplePositions[index]);
+    else
+    {
+        std::pair<base::Time, base::samples::Joints> nextSample;
+        if(!aggregator || !aggregator->getNextSample(streamIdx, nextSample) || nextSample.first <= atTime)
+            return false;
+
+        getPositions(nextSample.second, nextPositions);
+        interpolate(atTime, startTime, samplePositions[index - 1], nextSample.first, nextPositions);
+    }
+
+    for(size_t i = 0; i < elements.size(); i++)
+    {
+        //joints without position stay invalid
+        validPoses[i] = positions[i] == positions[i];
+        if(validPoses[i])
+            elements[i]->computePose(positions[i], poses[i]);
+    }
+
+    cacheValid = true;
+    cachedVersion = sampleVersion;
+    cachedTime = atTime;
+    cachedInterpolation = doInterpolation;
+    return true;
+}
+
+void JointStateStream::interpolate(const base::Time& atTime, const base::Time& startTime, const std::vector< double >& start,
+    const base::Time& endTime, const std::vector< double >& end)
+{
+    double factor = (atTime - startTime).toSeconds() / (endTime - startTime).toSeconds();
+    positions.resize(start.size());
+    for(size_t i = 0; i < positions.size(); i++)
+        positions[i] = elements[i]->interpolatePosition(start[i], end[i], factor);
+}
+
+bool JointStateStream::getSampleTimeAfter(const base::Time& time, base::Time& result) const
+{
+    std::deque<base::Time>::const_iterator it = std::upper_bound(sampleTimes.begin(), sampleTimes.end(), time);
+    if(it == sampleTimes.end())
+        return false;
+
+    result = *it;
+    return true;
+}
+
+bool JointStateStream::getJointPose(size_t index, const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose)
+{
+    if(!update(atTime, doInterpolation) || !validPoses[index])
+        return false;
+
+    pose = poses[index];
+    return true;
+}
+
+}
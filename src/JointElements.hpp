@@ -0,0 +1,254 @@
+#ifndef TRANSFORMER_JOINT_ELEMENTS_HPP
+#define TRANSFORMER_JOINT_ELEMENTS_HPP
+
+#include "Transformer.hpp"
+#include <base/samples/Joints.hpp>
+#include <deque>
+#include <cmath>
+
+namespace transformer
+{
+
+/**
+ * Describes a single degree of freedom joint between two frames
+ * */
+struct JointDescription
+{
+    enum Type
+    {
+	REVOLUTE,
+	PRISMATIC
+    };
+
+    /**
+     * @param name the name of the joint in the joint state samples
+     * @param sourceFrame the frame moved by the joint, i.e. the child link
+     * @param targetFrame the frame the joint is mounted on, i.e. the parent link
+     * @param axis the axis of the joint, in the joint frame
+     * @param origin the transformation from the joint frame at position
+     *   zero to the target frame
+     * */
+    JointDescription(const std::string &name, Type type, const std::string &sourceFrame, const std::string &targetFrame,
+	    const Eigen::Vector3d &axis, const Eigen::Isometry3d &origin = Eigen::Isometry3d::Identity())
+	: name(name), type(type), sourceFrame(sourceFrame), targetFrame(targetFrame), axis(axis.normalized()), origin(origin) {};
+
+    std::string name;
+    Type type;
+    std::string sourceFrame;
+    std::string targetFrame;
+    Eigen::Vector3d axis;
+    Eigen::Isometry3d origin;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+class JointStateStream;
+
+/**
+ * Base class of the elements representing a joint of a JointStateStream.
+ *
+ * The value of the element is the transformation from the child link to the
+ * parent link, computed from the joint position.
+ * */
+class JointTransformationElement : public TransformationElement
+{
+    public:
+	JointTransformationElement(const JointDescription &joint, JointStateStream &stream, size_t index)
+	    : TransformationElement(joint.sourceFrame, joint.targetFrame), axis(joint.axis), origin(joint.origin), stream(stream), index(index) {};
+
+	virtual bool getTransformation(const base::Time& atTime, bool doInterpolation, TransformationType& tr);
+
+	virtual bool getPose(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose);
+
+	virtual bool getSampleTimeAfter(const base::Time &time, base::Time &sampleTime) const;
+
+	/**
+	 * Computes the transformation of the joint at the given position
+	 * */
+	virtual void computePose(double position, Eigen::Isometry3d &pose) const = 0;
+
+	/**
+	 * Interpolates between two joint positions, factor being the relative
+	 * position between them
+	 * */
+	virtual double interpolatePosition(double start, double end, double factor) const
+	{
+	    return (1.0 - factor) * start + factor * end;
+	}
+
+	/**
+	 * Calls the registered callbacks, to be called when the stream got a
+	 * new sample
+	 * */
+	void jointsChanged(const base::Time &ts)
+	{
+	    notifyTransformationChanged(ts);
+	}
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    protected:
+	Eigen::Vector3d axis;
+	Eigen::Isometry3d origin;
+
+    private:
+	JointStateStream &stream;
+	///index of the joint in the stream
+	size_t index;
+};
+
+/**
+ * A joint rotating around its axis, the position is the angle in radians
+ * */
+class RevoluteJointElement : public JointTransformationElement
+{
+    public:
+	RevoluteJointElement(const JointDescription &joint, JointStateStream &stream, size_t index)
+	    : JointTransformationElement(joint, stream, index) {};
+
+	virtual void computePose(double position, Eigen::Isometry3d &pose) const
+	{
+	    pose.linear().noalias() = origin.linear() * Eigen::AngleAxisd(position, axis).toRotationMatrix();
+	    pose.translation() = origin.translation();
+	    pose.makeAffine();
+	}
+
+	/**
+	 * Interpolates along the shortest angular difference, so that
+	 * continuous joints do not go the long way around at +-pi
+	 * */
+	virtual double interpolatePosition(double start, double end, double factor) const
+	{
+	    double difference = end - start;
+	    return start + factor * atan2(sin(difference), cos(difference));
+	}
+};
+
+/**
+ * A joint translating along its axis, the position is the distance in
+ * meters
+ * */
+class PrismaticJointElement : public JointTransformationElement
+{
+    public:
+	PrismaticJointElement(const JointDescription &joint, JointStateStream &stream, size_t index)
+	    : JointTransformationElement(joint, stream, index) {};
+
+	virtual void computePose(double position, Eigen::Isometry3d &pose) const
+	{
+	    pose.linear() = origin.linear();
+	    pose.translation() = origin.translation() + origin.linear() * (axis * position);
+	    pose.makeAffine();
+	}
+};
+
+/**
+ * A set of joints fed by a single stream of joint state samples.
+ *
+ * Only the joint positions of the samples are kept, in a bounded history
+ * sorted by time. The transformations of all joints are computed in one
+ * pass on the first query for a given time, and reused by the following
+ * queries for the same time. Interpolation is done on the joint positions,
+ * between the samples of the history or, after the latest one, with the
+ * next sample of the aggregator stream.
+ * */
+class JointStateStream
+{
+    public:
+	/**
+	 * Creates the elements of the given joints. If aggregator is given,
+	 * a stream for the joint state samples gets registered on it.
+	 * historySize is the number of samples kept, see setHistorySize.
+	 * */
+	JointStateStream(const std::vector<JointDescription> &joints, aggregator::StreamAligner *aggregator, int priority, const std::string &name, size_t historySize = 100);
+	~JointStateStream();
+
+	/**
+	 * The elements of the joints, in the order of the descriptions given
+	 * to the constructor. The elements are meant to be handed over to a
+	 * TransformationTree, which deletes them.
+	 * */
+	const std::vector<JointTransformationElement *> &getElements() const
+	{
+	    return elements;
+	}
+
+	int getStreamIdx() const
+	{
+	    return streamIdx;
+	}
+
+	/**
+	 * Changes the number of samples kept in the history, dropping the
+	 * oldest ones if there are more. The size is at least one.
+	 * */
+	void setHistorySize(size_t size);
+
+	/**
+	 * Adds a sample to the history and calls the callbacks of all
+	 * elements. A sample with the same time as an existing one replaces
+	 * it. Samples older than the whole retained history are dropped.
+	 * */
+	void setJoints(const base::Time &ts, const base::samples::Joints &joints);
+
+	/**
+	 * Returns the transformation of the joint with the given index.
+	 * Without interpolation, the latest sample not after the given time is
+	 * used. Returns false if there is no sample for this time, or if the
+	 * sample has no position for this joint.
+	 * */
+	bool getJointPose(size_t index, const base::Time &atTime, bool doInterpolation, Eigen::Isometry3d &pose);
+
+	/**
+	 * Gets the time of the first sample of the history after the given
+	 * time
+	 * */
+	bool getSampleTimeAfter(const base::Time &time, base::Time &result) const;
+
+    private:
+	/**
+	 * Computes the transformations of all joints for the given query,
+	 * unless they already are
+	 * */
+	bool update(const base::Time &atTime, bool doInterpolation);
+
+	/**
+	 * Sets positions to the interpolation between the given samples
+	 * */
+	void interpolate(const base::Time &atTime, const base::Time &startTime, const std::vector<double> &start,
+		const base::Time &endTime, const std::vector<double> &end);
+
+	/**
+	 * Extracts the positions of the joints from the given sample, in the
+	 * order of the joint descriptions
+	 * */
+	void getPositions(const base::samples::Joints &joints, std::vector<double> &positions);
+
+	std::vector<std::string> jointNames;
+	std::vector<JointTransformationElement *> elements;
+	aggregator::StreamAligner *aggregator;
+	int streamIdx;
+
+	///index of each joint in the last sample names, see getPositions
+	std::vector<size_t> sampleIndices;
+	std::vector<std::string> sampleNames;
+
+	///the history, sorted by time
+	size_t historySize;
+	std::deque<base::Time> sampleTimes;
+	std::deque< std::vector<double> > samplePositions;
+	unsigned sampleVersion;
+
+	///the query the joint poses were last computed for
+	bool cacheValid;
+	unsigned cachedVersion;
+	base::Time cachedTime;
+	bool cachedInterpolation;
+	std::vector<double> positions;
+	std::vector<double> nextPositions;
+	std::vector<bool> validPoses;
+	std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> > poses;
+};
+
+}
+
+#endif
@@ -1,29 +1,151 @@
 #include "NonAligningTransformer.hpp"
+#include "JointElements.hpp"
 #include <base/logging.h>
+#include <limits>
 
-transformer::NonAlignedDynamicTransformationElement::NonAlignedDynamicTransformationElement(const std::string& sourceFrame, const std::string& targetFrame): TransformationElement(sourceFrame, targetFrame)
+transformer::NonAlignedDynamicTransformationElement::NonAlignedDynamicTransformationElement(const std::string& sourceFrame, const std::string& targetFrame, size_t historySize): TransformationElement(sourceFrame, targetFrame), history(historySize)
 {
-    gotTransform = false;
+}
+
+bool transformer::NonAlignedDynamicTransformationElement::lookup(const base::Time& atTime, bool doInterpolation, size_t& index, bool& interpolated, double& factor) const
+{
+    if(!history.find(atTime, index))
+        return false;
+
+    interpolated = false;
+    base::Time startTime = history.getTime(index);
+    if(!doInterpolation || atTime == startTime)
+        return true;
+
+    //there is nothing to interpolate with after the latest sample
+    if(index + 1 == history.size())
+        return false;
+
+    interpolated = true;
+    factor = (atTime - startTime).toSeconds() / (history.getTime(index + 1) - startTime).toSeconds();
+    return true;
 }
 
 bool transformer::NonAlignedDynamicTransformationElement::getTransformation(const base::Time& atTime, bool doInterpolation, transformer::TransformationType& result)
 {
-    if(doInterpolation)
-        throw std::runtime_error("Interpolated Transformation on nonAlignedTransformer requested");
-    
-    if(!gotTransform)
+    size_t index;
+    bool interpolated;
+    double factor;
+    if(!lookup(atTime, doInterpolation, index, interpolated, factor))
+    {
+        Eigen::Isometry3d pose;
+        if(!history.getArchivedPose(atTime, pose))
+            return false;
+
+        //the archive does not keep the covariances
+        result.initSane();
+        result.sourceFrame = getSourceFrame();
+        result.targetFrame = getTargetFrame();
+        result.time = atTime;
+        result.orientation = Eigen::Quaterniond(pose.linear());
+        result.position = pose.translation();
+        result.cov_position.setConstant(std::numeric_limits<double>::quiet_NaN());
+        result.cov_orientation.setConstant(std::numeric_limits<double>::quiet_NaN());
+        return true;
+    }
+
+    if(!interpolated && index + 1 == history.size())
+    {
+        result = lastTransform;
+        return true;
+    }
+
+    result.initSane();
+    result.sourceFrame = getSourceFrame();
+    result.targetFrame = getTargetFrame();
+    if(!interpolated)
+    {
+        result.time = history.getTime(index);
+        result.orientation = history.getOrientation(index);
+        result.position = history.getPosition(index);
+        result.cov_position = history.getPositionCovariance(index);
+        result.cov_orientation = history.getOrientationCovariance(index);
+        return true;
+    }
+
+    Eigen::Isometry3d pose;
+    interpolatePose(history.getOrientation(index), history.getPosition(index),
+            history.getOrientation(index + 1), history.getPosition(index + 1), factor, pose);
+    result.time = atTime;
+    result.orientation = Eigen::Quaterniond(pose.linear());
+    result.position = pose.translation();
+    result.cov_position = (1.0-factor) * history.getPositionCovariance(index) + factor * history.getPositionCovariance(index + 1);
+    result.cov_orientation = (1.0-factor) * history.getOrientationCovariance(index) + factor * history.getOrientationCovariance(index + 1);
+    return true;
+}
+
+bool transformer::NonAlignedDynamicTransformationElement::getPose(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose)
+{
+    size_t index;
+    bool interpolated;
+    double factor;
+    if(!lookup(atTime, doInterpolation, index, interpolated, factor))
+        return history.getArchivedPose(atTime, pose);
+
+    if(interpolated)
+        interpolatePose(history.getOrientation(index), history.getPosition(index),
+                history.getOrientation(index + 1), history.getPosition(index + 1), factor, pose);
+    else
+        history.getPose(index, pose);
+    return true;
+}
+
+bool transformer::NonAlignedDynamicTransformationElement::getPoseWithCovariance(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose, PoseCovariance& covariance)
+{
+    size_t index;
+    bool interpolated;
+    double factor;
+    //no fallback on the archive, archived samples carry no covariance
+    if(!lookup(atTime, doInterpolation, index, interpolated, factor))
         return false;
-    
-    result = lastTransform;
-    
+
+    covariance.setZero();
+    covariance.topLeftCorner<3, 3>() = history.getPositionCovariance(index);
+    covariance.bottomRightCorner<3, 3>() = history.getOrientationCovariance(index);
+    if(!interpolated)
+    {
+        history.getPose(index, pose);
+        return true;
+    }
+
+    interpolatePose(history.getOrientation(index), history.getPosition(index),
+            history.getOrientation(index + 1), history.getPosition(index + 1), factor, pose);
+
+    // perform linear interpolation of uncertainties
+    PoseCovariance endCovariance;
+    endCovariance.setZero();
+    endCovariance.topLeftCorner<3, 3>() = history.getPositionCovariance(index + 1);
+    endCovariance.bottomRightCorner<3, 3>() = history.getOrientationCovariance(index + 1);
+    covariance = (1.0-factor) * covariance + factor * endCovariance;
     return true;
 }
 
+bool transformer::NonAlignedDynamicTransformationElement::getExtrapolatedPose(const base::Time& atTime, bool doInterpolation, const ExtrapolationPolicy& policy, Eigen::Isometry3d& pose, bool& extrapolated)
+{
+    extrapolated = false;
+    if(getPose(atTime, doInterpolation, pose))
+        return true;
+
+    extrapolated = extrapolatePose(history, lastTransform, atTime, policy, pose);
+    return extrapolated;
+}
+
 void transformer::NonAlignedDynamicTransformationElement::setTransformation(const base::Time& atTime, const transformer::TransformationType& tr)
 {
-    gotTransform = true;
-    lastTransform = tr;
-    lastTransformTime = atTime;
+    if(!history.insert(atTime, tr))
+        return;
+
+    if(atTime >= lastTransformTime)
+    {
+        lastTransform = tr;
+        lastTransformTime = atTime;
+    }
+    notifyTransformationChanged(atTime);
     if(!elementChangedCallback.empty())
 	elementChangedCallback(atTime);
 }
@@ -48,27 +170,95 @@ void transformer::NonAligningTransformer::pushDynamicTransformation(const transf
     if(tr.time.isNull())
         throw std::runtime_error("Dynamic transformation without time given (or it is 1970 ;-P)");
 
-    std::map<std::pair<std::string, std::string>, NonAlignedDynamicTransformationElement *>::iterator it = transformToElementMap.find(std::make_pair(tr.sourceFrame, tr.targetFrame));
+    std::pair<FrameId, FrameId> key(transformationTree.getFrameId(tr.sourceFrame), transformationTree.getFrameId(tr.targetFrame));
+    std::map<std::pair<FrameId, FrameId>, NonAlignedDynamicTransformationElement *>::iterator it = transformToElementMap.find(key);
     
     //we got an unknown transformation
     if(it == transformToElementMap.end()) {
 
         //create a representation of the dynamic transformation
-        NonAlignedDynamicTransformationElement *dynamicElement = new NonAlignedDynamicTransformationElement(tr.sourceFrame, tr.targetFrame);
+        NonAlignedDynamicTransformationElement *dynamicElement = new NonAlignedDynamicTransformationElement(tr.sourceFrame, tr.targetFrame, historySize);
+        dynamicElement->configureArchive(archiveDuration, archivePositionTolerance, archiveOrientationTolerance);
         
-        transformToElementMap[std::make_pair(tr.sourceFrame, tr.targetFrame)] = dynamicElement;
+        transformToElementMap[key] = dynamicElement;
         
         LOG_DEBUG_S << "Registering new stream for transformation from " << tr.sourceFrame << " to " << tr.targetFrame;
         
         //add new dynamic element to transformation tree
-        transformationTree.addTransformation(dynamicElement);
-
-        recomputeAvailableTransformations();
+        addTransformationElement(dynamicElement);
         
-        it = transformToElementMap.find(std::make_pair(tr.sourceFrame, tr.targetFrame));
+        it = transformToElementMap.find(key);
         assert(it != transformToElementMap.end());
     }
 
     //set new transformation
     it->second->setTransformation(tr.time, tr);
+
+    if(tr.time > latestDynamicTime)
+        latestDynamicTime = tr.time;
+    checkIdleTransformations();
+}
+
+bool transformer::NonAligningTransformer::removeDynamicTransformation(const std::string& sourceFrame, const std::string& targetFrame)
+{
+    std::pair<FrameId, FrameId> key;
+    if(!transformationTree.findFrameId(sourceFrame, key.first) || !transformationTree.findFrameId(targetFrame, key.second))
+        return false;
+
+    std::map<std::pair<FrameId, FrameId>, NonAlignedDynamicTransformationElement *>::iterator it = transformToElementMap.find(key);
+    if(it == transformToElementMap.end())
+        return false;
+
+    LOG_DEBUG_S << "Removing dynamic transformation from " << sourceFrame << " to " << targetFrame;
+
+    NonAlignedDynamicTransformationElement *element = it->second;
+    transformToElementMap.erase(it);
+    removeTransformationElement(element);
+    return true;
+}
+
+void transformer::NonAligningTransformer::setHistorySize(size_t size)
+{
+    transformer::Transformer::setHistorySize(size);
+    for(std::map<std::pair<FrameId, FrameId>, NonAlignedDynamicTransformationElement *>::iterator it = transformToElementMap.begin();
+        it != transformToElementMap.end(); it++)
+        it->second->setHistorySize(size);
+}
+
+void transformer::NonAligningTransformer::setHistoryArchive(const base::Time& duration, double positionTolerance, double orientationTolerance)
+{
+    transformer::Transformer::setHistoryArchive(duration, positionTolerance, orientationTolerance);
+    for(std::map<std::pair<FrameId, FrameId>, NonAlignedDynamicTransformationElement *>::iterator it = transformToElementMap.begin();
+        it != transformToElementMap.end(); it++)
+        it->second->configureArchive(duration, positionTolerance, orientationTolerance);
+}
+
+void transformer::NonAligningTransformer::evictIdleTransformations(const base::Time& now)
+{
+    std::vector< std::pair<std::string, std::string> > idle;
+    for(std::map<std::pair<FrameId, FrameId>, NonAlignedDynamicTransformationElement *>::const_iterator it = transformToElementMap.begin();
+        it != transformToElementMap.end(); it++)
+    {
+        if(now - it->second->getLastTransformTime() > getIdleTimeout())
+            idle.push_back(std::make_pair(it->second->getSourceFrame(), it->second->getTargetFrame()));
+    }
+
+    if(idle.empty())
+        return;
+
+    beginTopologyUpdate();
+    for(std::vector< std::pair<std::string, std::string> >::const_iterator it = idle.begin(); it != idle.end(); it++)
+        removeDynamicTransformation(it->first, it->second);
+    commitTopologyUpdate();
+}
+
+void transformer::NonAligningTransformer::pushJointState(int idx, const base::samples::Joints& joints)
+{
+    if(joints.time.isNull())
+        throw std::runtime_error("Joint state without time given");
+
+    jointStreams.at(idx)->setJoints(joints.time, joints);
+
+    if(joints.time > latestDynamicTime)
+        latestDynamicTime = joints.time;
 }
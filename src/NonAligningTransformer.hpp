@@ -5,23 +5,84 @@
 
 namespace transformer
 {
+/**
+ * A dynamic transformation whose samples are set directly instead of going
+ * through the aggregator.
+ *
+ * The samples are kept in a bounded history sorted by time, samples arriving
+ * out of order are merged at their place. Interpolated queries use the two
+ * samples that bracket the query time, and fail after the latest sample.
+ * */
 class NonAlignedDynamicTransformationElement : public TransformationElement
 {
 public:
-    NonAlignedDynamicTransformationElement(const std::string& sourceFrame, const std::string& targetFrame);
+    NonAlignedDynamicTransformationElement(const std::string& sourceFrame, const std::string& targetFrame, size_t historySize = 100);
     virtual bool getTransformation(const base::Time& atTime, bool doInterpolation, TransformationType& result);
 
+    virtual bool getPose(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose);
+
+    /**
+     * Only answers from the history, as the archive does not keep the
+     * covariances
+     * */
+    virtual bool getPoseWithCovariance(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose, PoseCovariance& covariance);
+
+    virtual bool getExtrapolatedPose(const base::Time &atTime, bool doInterpolation, const ExtrapolationPolicy &policy, Eigen::Isometry3d &pose, bool &extrapolated);
+
+    virtual bool getSampleTimeAfter(const base::Time &time, base::Time &sampleTime) const
+    {
+        return history.getTimeAfter(time, sampleTime);
+    }
+
+    /**
+     * Adds a sample to the history. Samples older than the whole retained
+     * history are dropped.
+     * */
     void setTransformation(const base::Time& atTime, const TransformationType& tr);
+
+    const PoseHistory &getHistory() const
+    {
+        return history;
+    }
+
+    void setHistorySize(size_t size)
+    {
+        history.setCapacity(size);
+    }
+
+    void configureArchive(const base::Time &duration, double positionTolerance, double orientationTolerance)
+    {
+        history.getArchive().configure(duration, positionTolerance, orientationTolerance);
+    }
+
+    /**
+     * Returns the timestamp of the last sample given to setTransformation
+     * */
+    const base::Time &getLastTransformTime() const
+    {
+        return lastTransformTime;
+    }
     virtual void setTransformationChangedCallback(boost::function<void (const base::Time &ts)> callback)
     {
 	elementChangedCallback = callback;
     };
 
 private:
+    /**
+     * Looks up the samples for the given query. On success, index is the
+     * sample at or before atTime, and if interpolated is set, the value is
+     * interpolated between it and the next sample with the given factor.
+     * */
+    bool lookup(const base::Time &atTime, bool doInterpolation, size_t &index, bool &interpolated, double &factor) const;
+
     boost::function<void (const base::Time &ts)> elementChangedCallback;
     base::Time lastTransformTime;
+    ///the latest sample
     TransformationType lastTransform;
-    bool gotTransform;
+    PoseHistory history;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 };
     
@@ -34,9 +95,22 @@ public:
     virtual void clear();
     
     virtual void pushDynamicTransformation(const TransformationType& tr);
+
+    virtual bool removeDynamicTransformation(const std::string &sourceFrame, const std::string &targetFrame);
+
+    virtual void evictIdleTransformations(const base::Time &now);
+
+    virtual void setHistorySize(size_t size);
+
+    virtual void setHistoryArchive(const base::Time &duration, double positionTolerance, double orientationTolerance);
+
+    /**
+     * Gives the sample directly to the joint state stream
+     * */
+    virtual void pushJointState(int idx, const base::samples::Joints &joints);
     
 private:
-    std::map<std::pair<std::string, std::string>, NonAlignedDynamicTransformationElement *> transformToElementMap;
+    std::map<std::pair<FrameId, FrameId>, NonAlignedDynamicTransformationElement *> transformToElementMap;
 
 };
 
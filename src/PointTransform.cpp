@@ -0,0 +1,410 @@
+#include "PointTransform.hpp"
+#include <boost/scoped_array.hpp>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TRANSFORMER_POINTS_AVX2
+//the AVX2 kernels are compiled for AVX2 and FMA whatever the target of the
+//build is, and only called if the CPU supports both
+#define TRANSFORMER_AVX2_TARGET __attribute__((target("avx2,fma")))
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TRANSFORMER_POINTS_NEON
+#endif
+
+namespace transformer {
+
+namespace
+{
+
+/**
+ * The first three rows of a pose, in row-major order
+ * */
+template<class Scalar>
+struct PoseRows
+{
+    Scalar m[12];
+
+    explicit PoseRows(const Eigen::Isometry3d &pose)
+    {
+        for(int row = 0; row < 3; row++)
+        {
+            for(int col = 0; col < 4; col++)
+                m[row * 4 + col] = static_cast<Scalar>(pose.matrix()(row, col));
+        }
+    }
+};
+
+template<class Scalar>
+inline void transformPoint(const Scalar *m, Scalar x, Scalar y, Scalar z, Scalar &outX, Scalar &outY, Scalar &outZ)
+{
+    outX = m[0] * x + m[1] * y + m[2] * z + m[3];
+    outY = m[4] * x + m[5] * y + m[6] * z + m[7];
+    outZ = m[8] * x + m[9] * y + m[10] * z + m[11];
+}
+
+template<class Scalar>
+void transformSoAScalar(const Scalar *m, const Scalar *x, const Scalar *y, const Scalar *z,
+    Scalar *outX, Scalar *outY, Scalar *outZ, size_t begin, size_t count)
+{
+    for(size_t i = begin; i < count; i++)
+        transformPoint(m, x[i], y[i], z[i], outX[i], outY[i], outZ[i]);
+}
+
+template<class Scalar>
+void transformAoSScalar(const Scalar *m, const Scalar *in, Scalar *out, size_t begin, size_t count)
+{
+    for(size_t i = begin; i < count; i++)
+        transformPoint(m, in[3 * i], in[3 * i + 1], in[3 * i + 2], out[3 * i], out[3 * i + 1], out[3 * i + 2]);
+}
+
+#if defined(TRANSFORMER_POINTS_AVX2)
+bool cpuHasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+const bool useAvx2 = cpuHasAvx2();
+
+TRANSFORMER_AVX2_TARGET size_t transformSoAAvx2(const double *m, const double *x, const double *y, const double *z,
+    double *outX, double *outY, double *outZ, size_t count)
+{
+    __m256d r[12];
+    for(int k = 0; k < 12; k++)
+        r[k] = _mm256_set1_pd(m[k]);
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m256d px = _mm256_loadu_pd(x + i);
+        __m256d py = _mm256_loadu_pd(y + i);
+        __m256d pz = _mm256_loadu_pd(z + i);
+        __m256d ox = _mm256_fmadd_pd(r[0], px, _mm256_fmadd_pd(r[1], py, _mm256_fmadd_pd(r[2], pz, r[3])));
+        __m256d oy = _mm256_fmadd_pd(r[4], px, _mm256_fmadd_pd(r[5], py, _mm256_fmadd_pd(r[6], pz, r[7])));
+        __m256d oz = _mm256_fmadd_pd(r[8], px, _mm256_fmadd_pd(r[9], py, _mm256_fmadd_pd(r[10], pz, r[11])));
+        _mm256_storeu_pd(outX + i, ox);
+        _mm256_storeu_pd(outY + i, oy);
+        _mm256_storeu_pd(outZ + i, oz);
+    }
+    return i;
+}
+
+TRANSFORMER_AVX2_TARGET size_t transformSoAAvx2(const float *m, const float *x, const float *y, const float *z,
+    float *outX, float *outY, float *outZ, size_t count)
+{
+    __m256 r[12];
+    for(int k = 0; k < 12; k++)
+        r[k] = _mm256_set1_ps(m[k]);
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pz = _mm256_loadu_ps(z + i);
+        __m256 ox = _mm256_fmadd_ps(r[0], px, _mm256_fmadd_ps(r[1], py, _mm256_fmadd_ps(r[2], pz, r[3])));
+        __m256 oy = _mm256_fmadd_ps(r[4], px, _mm256_fmadd_ps(r[5], py, _mm256_fmadd_ps(r[6], pz, r[7])));
+        __m256 oz = _mm256_fmadd_ps(r[8], px, _mm256_fmadd_ps(r[9], py, _mm256_fmadd_ps(r[10], pz, r[11])));
+        _mm256_storeu_ps(outX + i, ox);
+        _mm256_storeu_ps(outY + i, oy);
+        _mm256_storeu_ps(outZ + i, oz);
+    }
+    return i;
+}
+
+/*
+ * The AoS kernels load the triplets of a group of points into three
+ * vectors, deinterleave them into coordinate vectors, apply the SoA
+ * computation and interleave the result again
+ * */
+
+TRANSFORMER_AVX2_TARGET size_t transformAoSAvx2(const double *m, const double *in, double *out, size_t count)
+{
+    __m256d r[12];
+    for(int k = 0; k < 12; k++)
+        r[k] = _mm256_set1_pd(m[k]);
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        //x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+        __m256d a = _mm256_loadu_pd(in + 3 * i);
+        __m256d b = _mm256_loadu_pd(in + 3 * i + 4);
+        __m256d c = _mm256_loadu_pd(in + 3 * i + 8);
+        //points 0 and 1 in the lower lanes, 2 and 3 in the upper ones
+        __m256d p = _mm256_permute2f128_pd(a, b, 0x30);
+        __m256d q = _mm256_permute2f128_pd(a, c, 0x21);
+        __m256d s = _mm256_permute2f128_pd(b, c, 0x30);
+        __m256d px = _mm256_shuffle_pd(p, q, 0xa);
+        __m256d py = _mm256_shuffle_pd(p, s, 0x5);
+        __m256d pz = _mm256_shuffle_pd(q, s, 0xa);
+        __m256d ox = _mm256_fmadd_pd(r[0], px, _mm256_fmadd_pd(r[1], py, _mm256_fmadd_pd(r[2], pz, r[3])));
+        __m256d oy = _mm256_fmadd_pd(r[4], px, _mm256_fmadd_pd(r[5], py, _mm256_fmadd_pd(r[6], pz, r[7])));
+        __m256d oz = _mm256_fmadd_pd(r[8], px, _mm256_fmadd_pd(r[9], py, _mm256_fmadd_pd(r[10], pz, r[11])));
+        p = _mm256_shuffle_pd(ox, oy, 0x0);
+        q = _mm256_shuffle_pd(oz, ox, 0xa);
+        s = _mm256_shuffle_pd(oy, oz, 0xf);
+        _mm256_storeu_pd(out + 3 * i, _mm256_permute2f128_pd(p, q, 0x20));
+        _mm256_storeu_pd(out + 3 * i + 4, _mm256_permute2f128_pd(s, p, 0x30));
+        _mm256_storeu_pd(out + 3 * i + 8, _mm256_permute2f128_pd(q, s, 0x31));
+    }
+    return i;
+}
+
+TRANSFORMER_AVX2_TARGET size_t transformAoSAvx2(const float *m, const float *in, float *out, size_t count)
+{
+    __m256 r[12];
+    for(int k = 0; k < 12; k++)
+        r[k] = _mm256_set1_ps(m[k]);
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 a = _mm256_loadu_ps(in + 3 * i);
+        __m256 b = _mm256_loadu_ps(in + 3 * i + 8);
+        __m256 c = _mm256_loadu_ps(in + 3 * i + 16);
+        //points 0 to 3 in the lower lanes, 4 to 7 in the upper ones, each
+        //as x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+        __m256 v0 = _mm256_permute2f128_ps(a, b, 0x30);
+        __m256 v1 = _mm256_permute2f128_ps(a, c, 0x21);
+        __m256 v2 = _mm256_permute2f128_ps(b, c, 0x30);
+        __m256 xy = _mm256_shuffle_ps(v1, v2, _MM_SHUFFLE(2,1,3,2));
+        __m256 yz = _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(1,0,2,1));
+        __m256 px = _mm256_shuffle_ps(v0, xy, _MM_SHUFFLE(2,0,3,0));
+        __m256 py = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3,1,2,0));
+        __m256 pz = _mm256_shuffle_ps(yz, v2, _MM_SHUFFLE(3,0,3,1));
+        __m256 ox = _mm256_fmadd_ps(r[0], px, _mm256_fmadd_ps(r[1], py, _mm256_fmadd_ps(r[2], pz, r[3])));
+        __m256 oy = _mm256_fmadd_ps(r[4], px, _mm256_fmadd_ps(r[5], py, _mm256_fmadd_ps(r[6], pz, r[7])));
+        __m256 oz = _mm256_fmadd_ps(r[8], px, _mm256_fmadd_ps(r[9], py, _mm256_fmadd_ps(r[10], pz, r[11])));
+        v0 = _mm256_shuffle_ps(_mm256_shuffle_ps(ox, oy, _MM_SHUFFLE(1,0,1,0)),
+            _mm256_shuffle_ps(oz, ox, _MM_SHUFFLE(1,1,0,0)), _MM_SHUFFLE(2,0,2,0));
+        v1 = _mm256_shuffle_ps(_mm256_shuffle_ps(oy, oz, _MM_SHUFFLE(2,1,2,1)),
+            _mm256_shuffle_ps(ox, oy, _MM_SHUFFLE(3,2,3,2)), _MM_SHUFFLE(2,0,2,0));
+        v2 = _mm256_shuffle_ps(_mm256_shuffle_ps(oz, ox, _MM_SHUFFLE(3,3,2,2)),
+            _mm256_shuffle_ps(oy, oz, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(2,0,2,0));
+        _mm256_storeu_ps(out + 3 * i, _mm256_permute2f128_ps(v0, v1, 0x20));
+        _mm256_storeu_ps(out + 3 * i + 8, _mm256_permute2f128_ps(v2, v0, 0x30));
+        _mm256_storeu_ps(out + 3 * i + 16, _mm256_permute2f128_ps(v1, v2, 0x31));
+    }
+    return i;
+}
+#endif
+
+/*
+ * The SIMD kernels process as many points as fit in full vectors and
+ * return the index of the first point left to the scalar code
+ * */
+
+size_t transformSoASimd(const double *m, const double *x, const double *y, const double *z,
+    double *outX, double *outY, double *outZ, size_t count)
+{
+    size_t i = 0;
+#if defined(TRANSFORMER_POINTS_AVX2)
+    if(useAvx2)
+        i = transformSoAAvx2(m, x, y, z, outX, outY, outZ, count);
+#elif defined(TRANSFORMER_POINTS_NEON) && defined(__aarch64__)
+    float64x2_t r[12];
+    for(int k = 0; k < 12; k++)
+        r[k] = vdupq_n_f64(m[k]);
+    for(; i + 2 <= count; i += 2)
+    {
+        float64x2_t px = vld1q_f64(x + i);
+        float64x2_t py = vld1q_f64(y + i);
+        float64x2_t pz = vld1q_f64(z + i);
+        vst1q_f64(outX + i, vfmaq_f64(vfmaq_f64(vfmaq_f64(r[3], r[2], pz), r[1], py), r[0], px));
+        vst1q_f64(outY + i, vfmaq_f64(vfmaq_f64(vfmaq_f64(r[7], r[6], pz), r[5], py), r[4], px));
+        vst1q_f64(outZ + i, vfmaq_f64(vfmaq_f64(vfmaq_f64(r[11], r[10], pz), r[9], py), r[8], px));
+    }
+#endif
+    return i;
+}
+
+size_t transformSoASimd(const float *m, const float *x, const float *y, const float *z,
+    float *outX, float *outY, float *outZ, size_t count)
+{
+    size_t i = 0;
+#if defined(TRANSFORMER_POINTS_AVX2)
+    if(useAvx2)
+        i = transformSoAAvx2(m, x, y, z, outX, outY, outZ, count);
+#elif defined(TRANSFORMER_POINTS_NEON)
+    for(; i + 4 <= count; i += 4)
+    {
+        float32x4_t px = vld1q_f32(x + i);
+        float32x4_t py = vld1q_f32(y + i);
+        float32x4_t pz = vld1q_f32(z + i);
+        vst1q_f32(outX + i, vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m[3]), pz, m[2]), py, m[1]), px, m[0]));
+        vst1q_f32(outY + i, vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m[7]), pz, m[6]), py, m[5]), px, m[4]));
+        vst1q_f32(outZ + i, vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m[11]), pz, m[10]), py, m[9]), px, m[8]));
+    }
+#endif
+    return i;
+}
+
+size_t transformAoSSimd(const double *m, const double *in, double *out, size_t count)
+{
+    size_t i = 0;
+#if defined(TRANSFORMER_POINTS_AVX2)
+    if(useAvx2)
+        i = transformAoSAvx2(m, in, out, count);
+#elif defined(TRANSFORMER_POINTS_NEON) && defined(__aarch64__)
+    float64x2_t r[12];
+    for(int k = 0; k < 12; k++)
+        r[k] = vdupq_n_f64(m[k]);
+    for(; i + 2 <= count; i += 2)
+    {
+        float64x2x3_t p = vld3q_f64(in + 3 * i);
+        float64x2x3_t o;
+        o.val[0] = vfmaq_f64(vfmaq_f64(vfmaq_f64(r[3], r[2], p.val[2]), r[1], p.val[1]), r[0], p.val[0]);
+        o.val[1] = vfmaq_f64(vfmaq_f64(vfmaq_f64(r[7], r[6], p.val[2]), r[5], p.val[1]), r[4], p.val[0]);
+        o.val[2] = vfmaq_f64(vfmaq_f64(vfmaq_f64(r[11], r[10], p.val[2]), r[9], p.val[1]), r[8], p.val[0]);
+        vst3q_f64(out + 3 * i, o);
+    }
+#endif
+    return i;
+}
+
+size_t transformAoSSimd(const float *m, const float *in, float *out, size_t count)
+{
+    size_t i = 0;
+#if defined(TRANSFORMER_POINTS_AVX2)
+    if(useAvx2)
+        i = transformAoSAvx2(m, in, out, count);
+#elif defined(TRANSFORMER_POINTS_NEON)
+    for(; i + 4 <= count; i += 4)
+    {
+        float32x4x3_t p = vld3q_f32(in + 3 * i);
+        float32x4x3_t o;
+        o.val[0] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m[3]), p.val[2], m[2]), p.val[1], m[1]), p.val[0], m[0]);
+        o.val[1] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m[7]), p.val[2], m[6]), p.val[1], m[5]), p.val[0], m[4]);
+        o.val[2] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m[11]), p.val[2], m[10]), p.val[1], m[9]), p.val[0], m[8]);
+        vst3q_f32(out + 3 * i, o);
+    }
+#endif
+    return i;
+}
+
+template<class Scalar>
+struct AoSPoints
+{
+    const Scalar *in;
+    Scalar *out;
+
+    AoSPoints(const Scalar *in, Scalar *out) : in(in), out(out) {}
+
+    void apply(const Eigen::Isometry3d &pose, size_t begin, size_t end) const
+    {
+        transformPoints(pose, in + 3 * begin, out + 3 * begin, end - begin);
+    }
+};
+
+template<class Scalar>
+struct SoAPoints
+{
+    const Scalar *x, *y, *z;
+    Scalar *outX, *outY, *outZ;
+
+    SoAPoints(const Scalar *x, const Scalar *y, const Scalar *z, Scalar *outX, Scalar *outY, Scalar *outZ)
+        : x(x), y(y), z(z), outX(outX), outY(outY), outZ(outZ) {}
+
+    void apply(const Eigen::Isometry3d &pose, size_t begin, size_t end) const
+    {
+        transformPoints(pose, x + begin, y + begin, z + begin, outX + begin, outY + begin, outZ + begin, end - begin);
+    }
+};
+
+template<class Points>
+bool deskew(const Transformation &transformation, const base::Time &startTime, const base::Time &endTime, size_t bins,
+    const Points &points, size_t count, bool interpolate)
+{
+    if(count == 0)
+        return true;
+    if(bins == 0)
+        bins = 1;
+    if(bins > count)
+        bins = count;
+
+    //acquisition time of the middle point of each bin
+    int64_t duration = (endTime - startTime).toMicroseconds();
+    std::vector<base::Time> times(bins);
+    for(size_t bin = 0; bin < bins; bin++)
+    {
+        size_t middle = (bin * count / bins + (bin + 1) * count / bins - 1) / 2;
+        int64_t offset = count > 1 ? duration * (int64_t)middle / (int64_t)(count - 1) : 0;
+        times[bin] = startTime + base::Time::fromMicroseconds(offset);
+    }
+
+    std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> > poses(bins);
+    boost::scoped_array<bool> valid(new bool[bins]);
+    if(transformation.get(&times[0], bins, &poses[0], valid.get(), interpolate) != bins)
+        return false;
+
+    for(size_t bin = 0; bin < bins; bin++)
+        points.apply(poses[bin], bin * count / bins, (bin + 1) * count / bins);
+    return true;
+}
+
+}
+
+bool hasVectorPointKernels()
+{
+#if defined(TRANSFORMER_POINTS_AVX2)
+    return useAvx2;
+#elif defined(TRANSFORMER_POINTS_NEON)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void transformPoints(const Eigen::Isometry3d& pose, const double* in, double* out, size_t count)
+{
+    PoseRows<double> rows(pose);
+    size_t done = transformAoSSimd(rows.m, in, out, count);
+    transformAoSScalar(rows.m, in, out, done, count);
+}
+
+void transformPoints(const Eigen::Isometry3d& pose, const float* in, float* out, size_t count)
+{
+    PoseRows<float> rows(pose);
+    size_t done = transformAoSSimd(rows.m, in, out, count);
+    transformAoSScalar(rows.m, in, out, done, count);
+}
+
+void transformPoints(const Eigen::Isometry3d& pose, const double* x, const double* y, const double* z,
+    double* outX, double* outY, double* outZ, size_t count)
+{
+    PoseRows<double> rows(pose);
+    size_t done = transformSoASimd(rows.m, x, y, z, outX, outY, outZ, count);
+    transformSoAScalar(rows.m, x, y, z, outX, outY, outZ, done, count);
+}
+
+void transformPoints(const Eigen::Isometry3d& pose, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, size_t count)
+{
+    PoseRows<float> rows(pose);
+    size_t done = transformSoASimd(rows.m, x, y, z, outX, outY, outZ, count);
+    transformSoAScalar(rows.m, x, y, z, outX, outY, outZ, done, count);
+}
+
+bool deskewPoints(const Transformation& transformation, const base::Time& startTime, const base::Time& endTime, size_t bins,
+    const double* in, double* out, size_t count, bool interpolate)
+{
+    return deskew(transformation, startTime, endTime, bins, AoSPoints<double>(in, out), count, interpolate);
+}
+
+bool deskewPoints(const Transformation& transformation, const base::Time& startTime, const base::Time& endTime, size_t bins,
+    const float* in, float* out, size_t count, bool interpolate)
+{
+    return deskew(transformation, startTime, endTime, bins, AoSPoints<float>(in, out), count, interpolate);
+}
+
+bool deskewPoints(const Transformation& transformation, const base::Time& startTime, const base::Time& endTime, size_t bins,
+    const double* x, const double* y, const double* z, double* outX, double* outY, double* outZ, size_t count, bool interpolate)
+{
+    return deskew(transformation, startTime, endTime, bins, SoAPoints<double>(x, y, z, outX, outY, outZ), count, interpolate);
+}
+
+bool deskewPoints(const Transformation& transformation, const base::Time& startTime, const base::Time& endTime, size_t bins,
+    const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ, size_t count, bool interpolate)
+{
+    return deskew(transformation, startTime, endTime, bins, SoAPoints<float>(x, y, z, outX, outY, outZ), count, interpolate);
+}
+
+}
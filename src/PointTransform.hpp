@@ -0,0 +1,66 @@
+#ifndef TRANSFORMER_POINT_TRANSFORM_HPP
+#define TRANSFORMER_POINT_TRANSFORM_HPP
+
+#include "Transformer.hpp"
+
+namespace transformer
+{
+
+/**
+ * Kernels that apply a rigid body transformation to contiguous point
+ * arrays.
+ *
+ * Points are either stored as x,y,z triplets (AoS) or as three separate
+ * coordinate arrays (SoA). On x86, the kernels use AVX2 code paths if the
+ * CPU supports AVX2 and FMA, which is checked at run time. On ARM, the NEON
+ * code paths are selected at compile time. Otherwise scalar code is used.
+ *
+ * All kernels allow in-place operation, i.e. the output arrays may be the
+ * input arrays.
+ * */
+
+/**
+ * Returns true if the kernels use a vector code path on this machine
+ * */
+bool hasVectorPointKernels();
+
+/**
+ * Transforms 'count' points stored as x,y,z triplets
+ * */
+void transformPoints(const Eigen::Isometry3d &pose, const double *in, double *out, size_t count);
+void transformPoints(const Eigen::Isometry3d &pose, const float *in, float *out, size_t count);
+
+/**
+ * Transforms 'count' points stored as separate coordinate arrays
+ * */
+void transformPoints(const Eigen::Isometry3d &pose, const double *x, const double *y, const double *z,
+	double *outX, double *outY, double *outZ, size_t count);
+void transformPoints(const Eigen::Isometry3d &pose, const float *x, const float *y, const float *z,
+	float *outX, float *outY, float *outZ, size_t count);
+
+/**
+ * Motion compensation of points acquired at regular intervals between
+ * startTime and endTime, as e.g. the beams of a laser scan: point i is
+ * acquired at startTime + i * (endTime - startTime) / (count - 1).
+ *
+ * The points are split into 'bins' groups of consecutive points. The
+ * transformation is computed once per bin, with a single batch query, at
+ * the acquisition time of the middle point of the bin, and applied to all
+ * points of the bin. With bins == count, each point gets transformed with
+ * the transformation at its own acquisition time.
+ *
+ * Returns false, leaving the output untouched, if the transformation is not
+ * available for one of the bins.
+ * */
+bool deskewPoints(const Transformation &transformation, const base::Time &startTime, const base::Time &endTime, size_t bins,
+	const double *in, double *out, size_t count, bool interpolate = true);
+bool deskewPoints(const Transformation &transformation, const base::Time &startTime, const base::Time &endTime, size_t bins,
+	const float *in, float *out, size_t count, bool interpolate = true);
+bool deskewPoints(const Transformation &transformation, const base::Time &startTime, const base::Time &endTime, size_t bins,
+	const double *x, const double *y, const double *z, double *outX, double *outY, double *outZ, size_t count, bool interpolate = true);
+bool deskewPoints(const Transformation &transformation, const base::Time &startTime, const base::Time &endTime, size_t bins,
+	const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, size_t count, bool interpolate = true);
+
+}
+
+#endif
@@ -0,0 +1,146 @@
+#include "PoseArchive.hpp"
+#include "Transformer.hpp"
+#include <algorithm>
+
+namespace transformer {
+
+///maximum number of pending samples, which bounds the cost of a push.
+///Reaching it turns the last pending sample into a key sample.
+static const size_t maxPendingSamples = 256;
+
+PoseArchive::PoseArchive()
+    : positionTolerance(0)
+    , orientationTolerance(0)
+{
+}
+
+void PoseArchive::configure(const base::Time& duration, double positionTolerance, double orientationTolerance)
+{
+    this->duration = duration;
+    this->positionTolerance = positionTolerance;
+    this->orientationTolerance = orientationTolerance;
+    clear();
+}
+
+void PoseArchive::clear()
+{
+    keyTimes.clear();
+    keyOrientations.clear();
+    keyPositions.clear();
+    pendingTimes.clear();
+    pendingOrientations.clear();
+    pendingPositions.clear();
+}
+
+bool PoseArchive::coversPending(int64_t us, const Eigen::Quaterniond& orientation, const Eigen::Vector3d& position) const
+{
+    int64_t startTime = keyTimes.back();
+    const Eigen::Quaterniond &startOrientation(keyOrientations.back());
+    const Eigen::Vector3d &startPosition(keyPositions.back());
+    double span = us - startTime;
+    Eigen::Isometry3d interpolated;
+    for(size_t i = 0; i < pendingTimes.size(); i++)
+    {
+        double factor = (pendingTimes[i] - startTime) / span;
+        interpolatePose(startOrientation, startPosition, orientation, position, factor, interpolated);
+        if((interpolated.translation() - pendingPositions[i]).norm() > positionTolerance)
+            return false;
+        if(Eigen::Quaterniond(interpolated.linear()).angularDistance(pendingOrientations[i]) > orientationTolerance)
+            return false;
+    }
+    return true;
+}
+
+void PoseArchive::push(const base::Time& time, const Eigen::Quaterniond& orientation, const Eigen::Vector3d& position)
+{
+    if(!isEnabled())
+        return;
+
+    int64_t us = time.toMicroseconds();
+    if(keyTimes.empty())
+    {
+        keyTimes.push_back(us);
+        keyOrientations.push_back(orientation);
+        keyPositions.push_back(position);
+        return;
+    }
+
+    if(us <= getLatestTime().toMicroseconds())
+        return;
+
+    if(pendingTimes.size() >= maxPendingSamples || !coversPending(us, orientation, position))
+    {
+        //the pending samples are covered up to the last one, which gets
+        //kept
+        keyTimes.push_back(pendingTimes.back());
+        keyOrientations.push_back(pendingOrientations.back());
+        keyPositions.push_back(pendingPositions.back());
+        pendingTimes.clear();
+        pendingOrientations.clear();
+        pendingPositions.clear();
+    }
+
+    pendingTimes.push_back(us);
+    pendingOrientations.push_back(orientation);
+    pendingPositions.push_back(position);
+    dropOldSamples();
+}
+
+void PoseArchive::dropOldSamples()
+{
+    //keep the last sample before the limit, so that the whole duration
+    //can be interpolated
+    int64_t limit = getLatestTime().toMicroseconds() - duration.toMicroseconds();
+    while(keyTimes.size() > 1 && keyTimes[1] <= limit)
+    {
+        keyTimes.pop_front();
+        keyOrientations.pop_front();
+        keyPositions.pop_front();
+    }
+}
+
+bool PoseArchive::getPose(const base::Time& atTime, Eigen::Isometry3d& pose) const
+{
+    int64_t us = atTime.toMicroseconds();
+    if(keyTimes.empty() || us < keyTimes.front() || us > getLatestTime().toMicroseconds())
+        return false;
+    if(us < getLatestTime().toMicroseconds() - duration.toMicroseconds())
+        return false;
+
+    if(us > keyTimes.back())
+    {
+        int64_t startTime = keyTimes.back();
+        double factor = double(us - startTime) / (pendingTimes.back() - startTime);
+        interpolatePose(keyOrientations.back(), keyPositions.back(), pendingOrientations.back(), pendingPositions.back(), factor, pose);
+        return true;
+    }
+
+    size_t index = std::upper_bound(keyTimes.begin(), keyTimes.end(), us) - keyTimes.begin() - 1;
+    if(keyTimes[index] == us)
+    {
+        pose.linear() = keyOrientations[index].toRotationMatrix();
+        pose.translation() = keyPositions[index];
+        pose.makeAffine();
+        return true;
+    }
+
+    double factor = double(us - keyTimes[index]) / (keyTimes[index + 1] - keyTimes[index]);
+    interpolatePose(keyOrientations[index], keyPositions[index], keyOrientations[index + 1], keyPositions[index + 1], factor, pose);
+    return true;
+}
+
+void PoseArchive::getLatest(Eigen::Quaterniond& orientation, Eigen::Vector3d& position) const
+{
+    if(pendingTimes.empty())
+    {
+        orientation = keyOrientations.back();
+        position = keyPositions.back();
+    }
+    else
+    {
+        orientation = pendingOrientations.back();
+        position = pendingPositions.back();
+    }
+}
+
+}
@@ -0,0 +1,142 @@
+#ifndef TRANSFORMER_POSE_ARCHIVE_HPP
+#define TRANSFORMER_POSE_ARCHIVE_HPP
+
+#include <Eigen/Geometry>
+#include <Eigen/StdDeque>
+#include <base/Time.hpp>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+namespace transformer
+{
+
+/**
+ * A compressed, long horizon store of the poses of a transformation.
+ *
+ * The samples, given in time order, are decimated: a sample is only kept if
+ * the trajectory between the kept samples around it, interpolated with
+ * interpolatePose like the history, would differ from it by more than the
+ * configured tolerances. Only times, orientations and positions are kept.
+ *
+ * Queries up to the configured duration before the latest sample are
+ * answered from the interpolated trajectory, and are within the tolerances
+ * at the times of the original samples. Older samples get dropped.
+ *
+ * The archive is disabled, and does not keep anything, until a duration is
+ * configured.
+ * */
+class PoseArchive
+{
+    public:
+	PoseArchive();
+
+	/**
+	 * Sets the span of the archive and the tolerances of the decimation,
+	 * and clears it. A zero duration disables the archive.
+	 *
+	 * @param positionTolerance in meters
+	 * @param orientationTolerance in radians
+	 * */
+	void configure(const base::Time &duration, double positionTolerance, double orientationTolerance);
+
+	bool isEnabled() const
+	{
+	    return !duration.isNull();
+	}
+
+	const base::Time &getDuration() const
+	{
+	    return duration;
+	}
+
+	double getPositionTolerance() const
+	{
+	    return positionTolerance;
+	}
+
+	double getOrientationTolerance() const
+	{
+	    return orientationTolerance;
+	}
+
+	bool empty() const
+	{
+	    return keyTimes.empty();
+	}
+
+	void clear();
+
+	/**
+	 * Adds a sample. Samples that are not after the latest one are
+	 * ignored, as are all samples if the archive is disabled.
+	 * */
+	void push(const base::Time &time, const Eigen::Quaterniond &orientation, const Eigen::Vector3d &position);
+
+	/**
+	 * Time of the oldest stored sample. The archive must not be empty.
+	 * */
+	base::Time getOldestTime() const
+	{
+	    return base::Time::fromMicroseconds(keyTimes.front());
+	}
+
+	/**
+	 * Time of the latest sample. The archive must not be empty.
+	 * */
+	base::Time getLatestTime() const
+	{
+	    return base::Time::fromMicroseconds(pendingTimes.empty() ? keyTimes.back() : pendingTimes.back());
+	}
+
+	/**
+	 * Computes the pose at the given time. Returns false if it is after
+	 * the latest sample, or further than the duration before it.
+	 * */
+	bool getPose(const base::Time &atTime, Eigen::Isometry3d &pose) const;
+
+	/**
+	 * Gets the latest sample. The archive must not be empty.
+	 * */
+	void getLatest(Eigen::Quaterniond &orientation, Eigen::Vector3d &position) const;
+
+	/**
+	 * Number of samples actually stored
+	 * */
+	size_t getStoredCount() const
+	{
+	    return keyTimes.size() + pendingTimes.size();
+	}
+
+    private:
+	/**
+	 * Returns true if all pending samples are within the tolerances of the
+	 * interpolation between the latest key sample and the given sample
+	 * */
+	bool coversPending(int64_t us, const Eigen::Quaterniond &orientation, const Eigen::Vector3d &position) const;
+
+	/**
+	 * Drops the key samples that are older than the duration
+	 * */
+	void dropOldSamples();
+
+	base::Time duration;
+	double positionTolerance;
+	double orientationTolerance;
+
+	///the decimated samples
+	std::deque<int64_t> keyTimes;
+	std::deque<Eigen::Quaterniond, Eigen::aligned_allocator<Eigen::Quaterniond> > keyOrientations;
+	std::deque<Eigen::Vector3d> keyPositions;
+
+	///the samples after the latest key sample, that are not decided yet.
+	///All but the last one are within the tolerances of the interpolation
+	///between the latest key sample and the last one.
+	std::vector<int64_t> pendingTimes;
+	std::vector<Eigen::Quaterniond, Eigen::aligned_allocator<Eigen::Quaterniond> > pendingOrientations;
+	std::vector<Eigen::Vector3d> pendingPositions;
+};
+
+}
+
+#endif
@@ -0,0 +1,221 @@
+#include "PoseHistory.hpp"
+#include "Transformer.hpp"
+#include <algorithm>
+
+namespace transformer {
+
+PoseHistory::PoseHistory(size_t capacity)
+    : capacity(0)
+    , first(0)
+    , count(0)
+    , cursor(0)
+{
+    setCapacity(capacity);
+}
+
+void PoseHistory::setCapacity(size_t newCapacity)
+{
+    if(newCapacity < 1)
+        newCapacity = 1;
+
+    //copy the retained samples to the start of the new arrays
+    size_t retained = std::min(count, newCapacity);
+    size_t dropped = count - retained;
+    std::vector<int64_t> newTimes(newCapacity);
+    std::vector<Eigen::Quaterniond, Eigen::aligned_allocator<Eigen::Quaterniond> > newOrientations(newCapacity);
+    std::vector<Eigen::Vector3d> newPositions(newCapacity);
+    std::vector<Eigen::Matrix3d> newPositionCovariances(newCapacity);
+    std::vector<Eigen::Matrix3d> newOrientationCovariances(newCapacity);
+    for(size_t i = 0; i < dropped; i++)
+        archiveSample(i);
+    for(size_t i = 0; i < retained; i++)
+    {
+        size_t from = physical(dropped + i);
+        newTimes[i] = times[from];
+        newOrientations[i] = orientations[from];
+        newPositions[i] = positions[from];
+        newPositionCovariances[i] = positionCovariances[from];
+        newOrientationCovariances[i] = orientationCovariances[from];
+    }
+
+    times.swap(newTimes);
+    orientations.swap(newOrientations);
+    positions.swap(newPositions);
+    positionCovariances.swap(newPositionCovariances);
+    orientationCovariances.swap(newOrientationCovariances);
+    capacity = newCapacity;
+    first = 0;
+    count = retained;
+    cursor = 0;
+}
+
+void PoseHistory::clear()
+{
+    first = 0;
+    count = 0;
+    cursor = 0;
+    archive.clear();
+}
+
+bool PoseHistory::push(const base::Time& time, const base::samples::RigidBodyState& sample)
+{
+    int64_t us = time.toMicroseconds();
+    size_t index;
+    if(count > 0 && us < times[physical(count - 1)])
+        return false;
+
+    if(count > 0 && us == times[physical(count - 1)])
+        index = physical(count - 1);
+    else if(count < capacity)
+    {
+        index = physical(count);
+        count++;
+    }
+    else
+    {
+        //overwrite the oldest sample
+        archiveSample(0);
+        index = first;
+        first = physical(1);
+        if(cursor > 0)
+            cursor--;
+    }
+
+    set(index, us, sample);
+    return true;
+}
+
+bool PoseHistory::insert(const base::Time& time, const base::samples::RigidBodyState& sample)
+{
+    int64_t us = time.toMicroseconds();
+    if(count == 0 || us >= times[physical(count - 1)])
+        return push(time, sample);
+
+    size_t pos = upperBound(us);
+    if(pos > 0 && times[physical(pos - 1)] == us)
+    {
+        set(physical(pos - 1), us, sample);
+        return true;
+    }
+
+    if(count == capacity)
+    {
+        if(pos == 0)
+            return false;
+
+        //drop the oldest sample to make room
+        archiveSample(0);
+        first = physical(1);
+        count--;
+        pos--;
+    }
+
+    //move the later samples up by one
+    for(size_t i = count; i > pos; i--)
+    {
+        size_t from = physical(i - 1);
+        size_t to = physical(i);
+        times[to] = times[from];
+        orientations[to] = orientations[from];
+        positions[to] = positions[from];
+        positionCovariances[to] = positionCovariances[from];
+        orientationCovariances[to] = orientationCovariances[from];
+    }
+    set(physical(pos), us, sample);
+    count++;
+    cursor = 0;
+    return true;
+}
+
+void PoseHistory::set(size_t index, int64_t us, const base::samples::RigidBodyState& sample)
+{
+    times[index] = us;
+    orientations[index] = sample.orientation;
+    positions[index] = sample.position;
+    positionCovariances[index] = sample.cov_position;
+    orientationCovariances[index] = sample.cov_orientation;
+}
+
+size_t PoseHistory::upperBound(int64_t us) const
+{
+    size_t low = 0;
+    size_t high = count;
+    while(low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if(times[physical(mid)] <= us)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+bool PoseHistory::find(const base::Time& atTime, size_t& index) const
+{
+    int64_t us = atTime.toMicroseconds();
+    if(count == 0 || us < times[first])
+        return false;
+
+    //queries usually move forward slowly, check the cursor and the sample
+    //after it first
+    if(cursor < count && times[physical(cursor)] <= us)
+    {
+        if(cursor + 1 == count || us < times[physical(cursor + 1)])
+        {
+            index = cursor;
+            return true;
+        }
+        if(cursor + 2 == count || us < times[physical(cursor + 2)])
+        {
+            cursor++;
+            index = cursor;
+            return true;
+        }
+    }
+
+    cursor = upperBound(us) - 1;
+    index = cursor;
+    return true;
+}
+
+bool PoseHistory::getTimeAfter(const base::Time& time, base::Time& sampleTime) const
+{
+    size_t index = upperBound(time.toMicroseconds());
+    if(index == count)
+        return false;
+
+    sampleTime = getTime(index);
+    return true;
+}
+
+void PoseHistory::getPose(size_t index, Eigen::Isometry3d& pose) const
+{
+    size_t i = physical(index);
+    pose.linear() = orientations[i].toRotationMatrix();
+    pose.translation() = positions[i];
+    pose.makeAffine();
+}
+
+bool PoseHistory::getArchivedPose(const base::Time& atTime, Eigen::Isometry3d& pose) const
+{
+    if(archive.empty())
+        return false;
+
+    base::Time archiveTime = archive.getLatestTime();
+    if(atTime <= archiveTime)
+        return archive.getPose(atTime, pose);
+
+    if(count == 0 || atTime >= getOldestTime())
+        return false;
+
+    //between the latest archived sample and the oldest retained one
+    Eigen::Quaterniond orientation;
+    Eigen::Vector3d position;
+    archive.getLatest(orientation, position);
+    double factor = (atTime - archiveTime).toSeconds() / (getOldestTime() - archiveTime).toSeconds();
+    interpolatePose(orientation, position, orientations[first], positions[first], factor, pose);
+    return true;
+}
+
+}
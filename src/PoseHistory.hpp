@@ -0,0 +1,189 @@
+#ifndef TRANSFORMER_POSE_HISTORY_HPP
+#define TRANSFORMER_POSE_HISTORY_HPP
+
+#include <Eigen/Geometry>
+#include <base/Time.hpp>
+#include <base/samples/rigid_body_state.h>
+#include "PoseArchive.hpp"
+#include <vector>
+#include <stdint.h>
+
+namespace transformer
+{
+
+/**
+ * A bounded, time ordered history of the samples of a transformation.
+ *
+ * The samples are kept in a ring buffer in structure of arrays layout:
+ * timestamps, orientations, positions and covariances are stored in separate
+ * arrays, so that a lookup only touches the timestamps and an evaluation
+ * only the poses. Once the capacity is reached, the oldest sample is dropped
+ * for every new one.
+ *
+ * Samples are addressed by their index, 0 being the oldest one.
+ *
+ * If the archive is enabled, the dropped samples are moved to it, so that
+ * the poses further in the past can still be queried with getArchivedPose.
+ * */
+class PoseHistory
+{
+    public:
+	PoseHistory(size_t capacity);
+
+	/**
+	 * Changes the maximum number of samples, dropping the oldest ones if
+	 * there are more. The capacity is at least one.
+	 * */
+	void setCapacity(size_t capacity);
+
+	size_t getCapacity() const
+	{
+	    return capacity;
+	}
+
+	size_t size() const
+	{
+	    return count;
+	}
+
+	bool empty() const
+	{
+	    return count == 0;
+	}
+
+	void clear();
+
+	/**
+	 * Appends a sample. A sample with the same time as the latest one
+	 * replaces it. Returns false, leaving the history untouched, if the
+	 * sample is older than the latest one.
+	 * */
+	bool push(const base::Time &time, const base::samples::RigidBodyState &sample);
+
+	/**
+	 * Inserts a sample at its place in time, e.g. a sample that arrived
+	 * late. A sample with the same time as an existing one replaces it.
+	 * If the history is full, the oldest sample gets dropped. Returns
+	 * false, leaving the history untouched, if the history is full and the
+	 * sample is older than all the retained ones.
+	 * */
+	bool insert(const base::Time &time, const base::samples::RigidBodyState &sample);
+
+	/**
+	 * Finds the latest sample whose time is not after atTime.
+	 *
+	 * Consecutive lookups at close times are answered from a cursor on
+	 * the last result, other ones with a binary search.
+	 *
+	 * Returns false if the history is empty or atTime is before the
+	 * oldest sample
+	 * */
+	bool find(const base::Time &atTime, size_t &index) const;
+
+	/**
+	 * Gets the time of the first sample after the given time. Returns
+	 * false if there is none.
+	 * */
+	bool getTimeAfter(const base::Time &time, base::Time &sampleTime) const;
+
+	base::Time getTime(size_t index) const
+	{
+	    return base::Time::fromMicroseconds(times[physical(index)]);
+	}
+
+	base::Time getLatestTime() const
+	{
+	    return getTime(count - 1);
+	}
+
+	base::Time getOldestTime() const
+	{
+	    return getTime(0);
+	}
+
+	const Eigen::Quaterniond &getOrientation(size_t index) const
+	{
+	    return orientations[physical(index)];
+	}
+
+	const Eigen::Vector3d &getPosition(size_t index) const
+	{
+	    return positions[physical(index)];
+	}
+
+	const Eigen::Matrix3d &getPositionCovariance(size_t index) const
+	{
+	    return positionCovariances[physical(index)];
+	}
+
+	const Eigen::Matrix3d &getOrientationCovariance(size_t index) const
+	{
+	    return orientationCovariances[physical(index)];
+	}
+
+	void getPose(size_t index, Eigen::Isometry3d &pose) const;
+
+	/**
+	 * Computes the pose at a time before the oldest sample from the
+	 * archive, interpolating between the latest archived sample and the
+	 * oldest sample if needed. Returns false if the time is not covered
+	 * by the archive.
+	 * */
+	bool getArchivedPose(const base::Time &atTime, Eigen::Isometry3d &pose) const;
+
+	PoseArchive &getArchive()
+	{
+	    return archive;
+	}
+
+	const PoseArchive &getArchive() const
+	{
+	    return archive;
+	}
+
+    private:
+	/**
+	 * Moves the sample at the given index to the archive
+	 * */
+	void archiveSample(size_t index)
+	{
+	    size_t i = physical(index);
+	    archive.push(base::Time::fromMicroseconds(times[i]), orientations[i], positions[i]);
+	}
+
+	/**
+	 * Returns the index of the first sample after the given time, or
+	 * size() if there is none
+	 * */
+	size_t upperBound(int64_t us) const;
+
+	/**
+	 * Sets the sample at the given physical index
+	 * */
+	void set(size_t index, int64_t us, const base::samples::RigidBodyState &sample);
+
+	size_t physical(size_t index) const
+	{
+	    size_t i = first + index;
+	    return i < capacity ? i : i - capacity;
+	}
+
+	size_t capacity;
+	///physical index of the oldest sample
+	size_t first;
+	size_t count;
+	///index of the result of the last lookup
+	mutable size_t cursor;
+
+	std::vector<int64_t> times;
+	std::vector<Eigen::Quaterniond, Eigen::aligned_allocator<Eigen::Quaterniond> > orientations;
+	std::vector<Eigen::Vector3d> positions;
+	std::vector<Eigen::Matrix3d> positionCovariances;
+	std::vector<Eigen::Matrix3d> orientationCovariances;
+
+	PoseArchive archive;
+};
+
+}
+
+#endif
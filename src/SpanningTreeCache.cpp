@@ -0,0 +1,230 @@
+#include "SpanningTreeCache.hpp"
+#include <Eigen/LU>
+#include <base/logging.h>
+#include <algorithm>
+
+namespace transformer {
+
+SpanningTreeCache::SpanningTreeCache(TransformationTree& tree)
+    : tree(tree)
+    , dirty(true)
+    , generation(1)
+{
+}
+
+SpanningTreeCache::~SpanningTreeCache()
+{
+    invalidate();
+}
+
+void SpanningTreeCache::invalidate()
+{
+    for(std::vector<TransformationElement *>::iterator it = trackedElements.begin(); it != trackedElements.end(); it++)
+    {
+        (*it)->removeTransformationChangedCallbacks(this);
+    }
+    trackedElements.clear();
+    dirty = true;
+}
+
+void SpanningTreeCache::elementChanged(const base::Time& ts)
+{
+    generation++;
+    if(generation == 0)
+        generation = 1;
+}
+
+void SpanningTreeCache::rebuild()
+{
+    invalidate();
+    elementChanged(base::Time());
+
+    size_t frameCount = tree.getFrameCount();
+    entries.clear();
+    entries.resize(frameCount);
+
+    //breadth-first traversal from the first unvisited frame of each component
+    std::vector<FrameId> queue;
+    queue.reserve(frameCount);
+    for(FrameId root = 0; root < (FrameId)frameCount; root++)
+    {
+        if(entries[root].root != -1)
+            continue;
+
+        entries[root].root = root;
+        queue.clear();
+        queue.push_back(root);
+        for(size_t i = 0; i < queue.size(); i++)
+        {
+            FrameId frame = queue[i];
+            const std::vector<TransformationEdge> &edges(tree.getEdges(frame));
+            for(std::vector<TransformationEdge>::const_iterator it = edges.begin(); it != edges.end(); it++)
+            {
+                Entry &child(entries[it->target]);
+                if(child.root != -1)
+                    continue;
+
+                child.root = root;
+                child.parent = frame;
+                child.parentEdge = *it;
+                child.depth = entries[frame].depth + 1;
+                queue.push_back(it->target);
+
+                it->element->addTransformationChangedCallback(boost::bind(&SpanningTreeCache::elementChanged, this, _1), this);
+                trackedElements.push_back(it->element);
+            }
+        }
+    }
+
+    dirty = false;
+}
+
+FrameId SpanningTreeCache::getRoot(FrameId frame)
+{
+    if(dirty || entries.size() != tree.getFrameCount())
+        rebuild();
+    return entries[frame].root;
+}
+
+bool SpanningTreeCache::isCached(const Entry& entry, const base::Time& atTime, bool interpolate) const
+{
+    return entry.generation == generation && entry.time == atTime && entry.interpolate == interpolate;
+}
+
+FrameId SpanningTreeCache::getLowestCommonAncestor(FrameId a, FrameId b) const
+{
+    while(entries[a].depth > entries[b].depth)
+        a = entries[a].parent;
+    while(entries[b].depth > entries[a].depth)
+        b = entries[b].parent;
+    while(a != b)
+    {
+        a = entries[a].parent;
+        b = entries[b].parent;
+    }
+    return a;
+}
+
+static bool getEdgeTransformation(const TransformationEdge &edge, const base::Time &atTime, bool interpolate, Eigen::Affine3d &result)
+{
+    Eigen::Isometry3d pose;
+    if(!edge.element->getPose(atTime, interpolate, pose))
+        return false;
+
+    if(edge.inverse)
+        pose = pose.inverse(Eigen::Isometry);
+    result = pose;
+    return true;
+}
+
+bool SpanningTreeCache::updateRootToFrame(FrameId frame, const base::Time& atTime, bool interpolate)
+{
+    //walk up until a frame with an up-to-date value (or the root) is found
+    pending.clear();
+    FrameId cur = frame;
+    while(!isCached(entries[cur], atTime, interpolate))
+    {
+        if(entries[cur].parent == -1)
+        {
+            Entry &root(entries[cur]);
+            root.rootToFrame = Eigen::Affine3d::Identity();
+            root.generation = generation;
+            root.time = atTime;
+            root.interpolate = interpolate;
+            break;
+        }
+        pending.push_back(cur);
+        cur = entries[cur].parent;
+    }
+
+    //and compose the values back down
+    for(std::vector<FrameId>::reverse_iterator it = pending.rbegin(); it != pending.rend(); it++)
+    {
+        Entry &entry(entries[*it]);
+        Eigen::Affine3d edge;
+        if(!getEdgeTransformation(entry.parentEdge, atTime, interpolate, edge))
+            return false;
+
+        entry.rootToFrame = edge * entries[entry.parent].rootToFrame;
+        entry.generation = generation;
+        entry.time = atTime;
+        entry.interpolate = interpolate;
+    }
+    return true;
+}
+
+bool SpanningTreeCache::composeFromAncestor(FrameId ancestor, FrameId frame, const base::Time& atTime, bool interpolate, Eigen::Affine3d& result)
+{
+    result = Eigen::Affine3d::Identity();
+    for(FrameId cur = frame; cur != ancestor; cur = entries[cur].parent)
+    {
+        Eigen::Affine3d edge;
+        if(!getEdgeTransformation(entries[cur].parentEdge, atTime, interpolate, edge))
+            return false;
+        result = result * edge;
+    }
+    return true;
+}
+
+bool SpanningTreeCache::get(FrameId source, FrameId target, const base::Time& atTime, bool interpolate, Eigen::Affine3d& result)
+{
+    if(dirty || entries.size() != tree.getFrameCount())
+        rebuild();
+
+    if(source == target)
+    {
+        result = Eigen::Affine3d::Identity();
+        return true;
+    }
+
+    if(entries[source].root != entries[target].root)
+        return false;
+
+    if(updateRootToFrame(source, atTime, interpolate) && updateRootToFrame(target, atTime, interpolate))
+    {
+        result = entries[target].rootToFrame * entries[source].rootToFrame.inverse();
+        return true;
+    }
+
+    //some transformation above the two frames is missing, compose the two
+    //branches below their lowest common ancestor
+    FrameId lca = getLowestCommonAncestor(source, target);
+    Eigen::Affine3d lcaToSource, lcaToTarget;
+    if(!composeFromAncestor(lca, source, atTime, interpolate, lcaToSource) ||
+        !composeFromAncestor(lca, target, atTime, interpolate, lcaToTarget))
+        return false;
+
+    result = lcaToTarget * lcaToSource.inverse();
+    return true;
+}
+
+bool SpanningTreeCache::getTransformationChain(FrameId source, FrameId target, std::vector< TransformationEdge >& result)
+{
+    if(dirty || entries.size() != tree.getFrameCount())
+        rebuild();
+
+    result.clear();
+    if(source == target)
+        return true;
+
+    if(entries[source].root != entries[target].root)
+        return false;
+
+    FrameId lca = getLowestCommonAncestor(source, target);
+
+    //edges down to the target, starting at the target
+    for(FrameId cur = target; cur != lca; cur = entries[cur].parent)
+        result.push_back(entries[cur].parentEdge);
+
+    //edges up from the source, in reverse order
+    size_t upStart = result.size();
+    for(FrameId cur = source; cur != lca; cur = entries[cur].parent)
+    {
+        const TransformationEdge &edge(entries[cur].parentEdge);
+        result.push_back(TransformationEdge(edge.element, !edge.inverse, entries[cur].parent));
+    }
+    std::reverse(result.begin() + upStart, result.end());
+    return true;
+}
+
+}
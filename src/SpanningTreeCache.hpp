@@ -0,0 +1,114 @@
+#ifndef TRANSFORMER_SPANNING_TREE_CACHE_HPP
+#define TRANSFORMER_SPANNING_TREE_CACHE_HPP
+
+#include "Transformer.hpp"
+
+namespace transformer
+{
+
+/**
+ * Keeps a spanning tree of a TransformationTree and caches, for the last
+ * requested time, the transformation from the root of the spanning tree to
+ * each frame.
+ *
+ * With T_f the transformation from the root to frame f (i.e. the composition
+ * of the tree edges from the root down to f), the transformation from a
+ * source to a target frame is T_target * T_source^-1. Once the upper part of
+ * the tree has been evaluated for a given time, any further query at that
+ * time costs at most one composition per frame that has not been evaluated
+ * yet, independently of the chain length.
+ *
+ * If a transformation between the root and the lowest common ancestor of
+ * source and target is not available, the query falls back to composing the
+ * two branches below the lowest common ancestor.
+ *
+ * The cache gets invalidated whenever one of the dynamic elements of the
+ * spanning tree receives a new sample.
+ * */
+class SpanningTreeCache
+{
+    public:
+	SpanningTreeCache(TransformationTree &tree);
+	~SpanningTreeCache();
+
+	/**
+	 * Marks the spanning tree as outdated. It will be recomputed on the
+	 * next query.
+	 *
+	 * This must be called before any element of the underlying tree gets
+	 * deleted, as it removes the callbacks registered on the elements.
+	 * */
+	void invalidate();
+
+	/**
+	 * Computes the transformation from 'source' to 'target' at the given
+	 * time.
+	 *
+	 * Returns false if the frames are not connected or if one of the
+	 * needed samples is not available
+	 * */
+	bool get(FrameId source, FrameId target, const base::Time &atTime, bool interpolate, Eigen::Affine3d &result);
+
+	/**
+	 * Returns the chain between 'source' and 'target' along the spanning
+	 * tree, in the same order than TransformationTree::getTransformationChain
+	 * */
+	bool getTransformationChain(FrameId source, FrameId target, std::vector<TransformationEdge> &result);
+
+	/**
+	 * Returns the root of the spanning tree the given frame belongs to
+	 * */
+	FrameId getRoot(FrameId frame);
+
+    private:
+	struct Entry
+	{
+	    Entry() : parentEdge(NULL, false, -1), parent(-1), root(-1), depth(0), generation(0), interpolate(false) {};
+
+	    ///edge from the parent to this frame
+	    TransformationEdge parentEdge;
+	    FrameId parent;
+	    FrameId root;
+	    int depth;
+
+	    ///cache generation, time and interpolation flag of rootToFrame
+	    unsigned generation;
+	    base::Time time;
+	    bool interpolate;
+	    Eigen::Affine3d rootToFrame;
+
+	    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	};
+
+	TransformationTree &tree;
+	std::vector<Entry, Eigen::aligned_allocator<Entry> > entries;
+	///elements on which a callback got registered
+	std::vector<TransformationElement *> trackedElements;
+	bool dirty;
+	///current cache generation. A value of 0 is never used by valid entries
+	unsigned generation;
+	///reused storage for the frames that need to be evaluated
+	std::vector<FrameId> pending;
+
+	SpanningTreeCache(const SpanningTreeCache &other);
+
+	void rebuild();
+	void elementChanged(const base::Time &ts);
+	bool isCached(const Entry &entry, const base::Time &atTime, bool interpolate) const;
+	FrameId getLowestCommonAncestor(FrameId a, FrameId b) const;
+
+	/**
+	 * Makes sure that rootToFrame of the given frame is up to date.
+	 * Returns false if a needed sample is missing
+	 * */
+	bool updateRootToFrame(FrameId frame, const base::Time &atTime, bool interpolate);
+
+	/**
+	 * Composes the tree edges from ancestor down to frame
+	 * */
+	bool composeFromAncestor(FrameId ancestor, FrameId frame, const base::Time &atTime, bool interpolate, Eigen::Affine3d &result);
+};
+
+}
+
+#endif
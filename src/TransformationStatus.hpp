@@ -54,13 +54,20 @@ namespace transformer
          * available
          */
         uint64_t failed_interpolation_impossible;
+        /** The number of generated transformations that had to be
+         * extrapolated after the latest sample of a dynamic transformation,
+         * see Transformation::setExtrapolation. They are included in
+         * generated_transformations
+         */
+        uint64_t extrapolated_transformations;
 
         TransformationStatus()
             : chain_length(0)
             , generated_transformations(0)
             , failed_no_chain(0)
             , failed_no_sample(0)
-            , failed_interpolation_impossible(0) {}
+            , failed_interpolation_impossible(0)
+            , extrapolated_transformations(0) {}
     };
     
     /** 
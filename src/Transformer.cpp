@@ -1,8 +1,15 @@
 #include <transformer/Transformer.hpp>
+#include <transformer/SpanningTreeCache.hpp>
+#include <transformer/ChainSegmentCache.hpp>
+#include <transformer/JointElements.hpp>
 #include <Eigen/LU>
 #include <Eigen/SVD>
 #include <assert.h>
 #include <base/logging.h>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <limits>
 
 namespace transformer {
     
@@ -29,66 +36,541 @@ void Transformation::updateStatus(TransformationStatus& status) const
     status.failed_no_sample = failedNoSample;
     status.failed_no_chain = failedNoChain;
     status.failed_interpolation_impossible = failedInterpolationImpossible;
+    status.extrapolated_transformations = extrapolatedTransformations;
+}
+
+void invertTransformation(TransformationType& tr)
+{
+    //closed form inverse of a rigid body transformation
+    tr.orientation = tr.orientation.conjugate();
+    tr.position = -(tr.orientation * tr.position);
+    std::swap(tr.sourceFrame, tr.targetFrame);
+}
+
+void toPose(const TransformationType& tr, Eigen::Isometry3d& pose)
+{
+    pose.linear() = tr.orientation.toRotationMatrix();
+    pose.translation() = tr.position;
+    pose.makeAffine();
+}
+
+bool TransformationElement::getPose(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose)
+{
+    TransformationType tr;
+    if(!getTransformation(atTime, doInterpolation, tr))
+        return false;
+    toPose(tr, pose);
+    return true;
+}
+
+void TransformationElement::getPoses(const base::Time* times, size_t count, bool doInterpolation, Eigen::Isometry3d* poses, bool* valid)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        if(valid[i])
+            valid[i] = getPose(times[i], doInterpolation, poses[i]);
+    }
+}
+
+bool TransformationElement::getPoseWithCovariance(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose, PoseCovariance& covariance)
+{
+    TransformationType tr;
+    if(!getTransformation(atTime, doInterpolation, tr))
+        return false;
+    toPose(tr, pose);
+    toPoseCovariance(tr, covariance);
+    return true;
+}
+
+void TransformationElement::getPosesWithCovariance(const base::Time* times, size_t count, bool doInterpolation, Eigen::Isometry3d* poses, PoseCovariance* covariances, bool* valid)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        if(valid[i])
+            valid[i] = getPoseWithCovariance(times[i], doInterpolation, poses[i], covariances[i]);
+    }
+}
+
+bool TransformationElement::getExtrapolatedPose(const base::Time& atTime, bool doInterpolation, const ExtrapolationPolicy& policy, Eigen::Isometry3d& pose, bool& extrapolated)
+{
+    extrapolated = false;
+    return getPose(atTime, doInterpolation, pose);
 }
 
 void Transformation::setTransformationChain(const std::vector< TransformationElement* >& chain)
 {
+    std::vector<TransformationEdge> edges;
+    edges.reserve(chain.size());
+    for(std::vector< TransformationElement* >::const_iterator it = chain.begin(); it != chain.end(); it++)
+    {
+        InverseTransformationElement *invElem = dynamic_cast<InverseTransformationElement *>(*it);
+        if(invElem)
+            edges.push_back(TransformationEdge(invElem->getElement(), true, -1));
+        else
+            edges.push_back(TransformationEdge(*it, false, -1));
+    }
+    //manually given chains are not known to the tree cache, and the
+    //lifetime of their elements is unknown to the segment cache
+    treeCache = NULL;
+    releaseSegments();
+    segmentCache = NULL;
+    setTransformationChain(edges);
+}
+
+void Transformation::setTransformationChain(const std::vector< TransformationEdge >& chain)
+{
+    removeChainCallbacks();
+    releaseSegments();
     transformationChain = chain;
     valid = true;
+    version++;
+    buildSegments();
     
+    registerChainCallbacks();
+
     if(!transformationChangedCallback.empty())
     {
-	for(std::vector< TransformationElement* >::iterator it = transformationChain.begin();
+	for(std::vector< TransformationEdge >::iterator it = transformationChain.begin();
 	it != transformationChain.end(); it++)
 	{
-            StaticTransformationElement *staticElem = dynamic_cast<StaticTransformationElement *>(*it);;
-            InverseTransformationElement *invElem = dynamic_cast<InverseTransformationElement *>(*it);
-            if(invElem)
-            {
-                staticElem = dynamic_cast<StaticTransformationElement *>(invElem->getElement());
-            }
-            if(staticElem)
+            if(dynamic_cast<StaticTransformationElement *>(it->element))
             {
-                //call the callback, as the transformation will never 'change' again 
+                //call the callback, as the transformation will only change
+                //again if the static transformation gets updated
                 transformationChangedCallback(base::Time());
             }
-            else
-                (*it)->addTransformationChangedCallback(transformationChangedCallback);
 	}
     }
 }
 
+void Transformation::registerChainCallbacks()
+{
+    for(std::vector< TransformationEdge >::iterator it = transformationChain.begin();
+        it != transformationChain.end(); it++)
+    {
+        //the static transform must be up to date before the user gets notified
+        bool isStatic = dynamic_cast<StaticTransformationElement *>(it->element);
+        it->element->addTransformationChangedCallback(boost::bind(&Transformation::elementChanged, this, _1, isStatic), this);
+
+        if(!transformationChangedCallback.empty())
+            it->element->addTransformationChangedCallback(transformationChangedCallback, this);
+    }
+}
+
+void Transformation::elementChanged(const base::Time& ts, bool isStatic)
+{
+    version++;
+    if(isStatic)
+        staticTransformDirty = true;
+}
+
+void Transformation::invalidateChain()
+{
+    removeChainCallbacks();
+    releaseSegments();
+    transformationChain.clear();
+    valid = false;
+    version++;
+}
+
+Transformation::~Transformation()
+{
+    releaseSegments();
+}
+
+void Transformation::buildSegments()
+{
+    size_t begin = 0;
+    while(begin < transformationChain.size())
+    {
+        bool isStatic = dynamic_cast<StaticTransformationElement *>(transformationChain[begin].element);
+        size_t end = begin + 1;
+        if(isStatic)
+        {
+            while(end < transformationChain.size() && dynamic_cast<StaticTransformationElement *>(transformationChain[end].element))
+                end++;
+        }
+
+        std::vector<TransformationEdge> edges(transformationChain.begin() + begin, transformationChain.begin() + end);
+        ChainSegment *parent = segments.empty() ? NULL : segments.back();
+        if(segmentCache)
+            segments.push_back(segmentCache->acquire(parent, edges, isStatic));
+        else
+            segments.push_back(new ChainSegment(parent, edges, isStatic));
+        begin = end;
+    }
+
+    staticChain = segments.empty() || (segments.size() == 1 && segments.front()->isStatic());
+    staticTransformDirty = true;
+}
+
+void Transformation::releaseSegments()
+{
+    //children first, their keys refer to their parents
+    for(std::vector<ChainSegment *>::reverse_iterator it = segments.rbegin(); it != segments.rend(); it++)
+    {
+        if(segmentCache)
+            segmentCache->release(*it);
+        else
+            delete *it;
+    }
+    segments.clear();
+}
+
+void Transformation::updateStaticTransform() const
+{
+    staticTransformDirty = false;
+    if(segments.empty())
+    {
+        staticTransform = Eigen::Isometry3d::Identity();
+        return;
+    }
+
+    segments.front()->update(base::Time(), false);
+    staticTransform = segments.front()->getValue();
+}
+
+bool Transformation::evaluateSegments(const base::Time& atTime, bool interpolate, Eigen::Isometry3d& result) const
+{
+    for(std::vector<ChainSegment *>::const_iterator it = segments.begin(); it != segments.end(); it++)
+    {
+        if(!(*it)->update(atTime, interpolate))
+        {
+            if(extrapolateChain(atTime, interpolate, result))
+                return true;
+
+            if (interpolate)
+                failedInterpolationImpossible++;
+            else
+                failedNoSample++;
+
+            //no sample available, return
+            return false;
+        }
+    }
+
+    result = segments.back()->getValue();
+    return true;
+}
+
+size_t Transformation::get(const base::Time* times, size_t count, Eigen::Isometry3d* results, bool* valid, bool interpolate) const
+{
+    if(!this->valid)
+    {
+        std::fill(valid, valid + count, false);
+        failedNoChain += count;
+        return 0;
+    }
+
+    if(treeCache)
+    {
+        //the tree cache only keeps the values for a single time
+        size_t validCount = 0;
+        Eigen::Affine3d tr;
+        for(size_t i = 0; i < count; i++)
+        {
+            valid[i] = get(times[i], tr, interpolate);
+            if(valid[i])
+            {
+                results[i].matrix() = tr.matrix();
+                validCount++;
+            }
+        }
+        return validCount;
+    }
+
+    std::fill(valid, valid + count, true);
+    for(size_t i = 0; i < count; i++)
+        results[i].setIdentity();
+
+    batchPoses.resize(count);
+    Eigen::Isometry3d composed;
+    for(std::vector<ChainSegment *>::const_iterator it = segments.begin(); it != segments.end(); it++)
+    {
+        if((*it)->isStatic())
+        {
+            const Eigen::Isometry3d &step((*it)->getStaticStep());
+            for(size_t i = 0; i < count; i++)
+            {
+                CompositionTraits<Eigen::Isometry3d>::compose(results[i], step, composed);
+                results[i] = composed;
+            }
+            continue;
+        }
+
+        const TransformationEdge &edge((*it)->getEdges().front());
+        edge.element->getPoses(times, count, interpolate, &batchPoses[0], valid);
+        for(size_t i = 0; i < count; i++)
+        {
+            if(!valid[i])
+                continue;
+            if(edge.inverse)
+                batchPoses[i] = batchPoses[i].inverse(Eigen::Isometry);
+            CompositionTraits<Eigen::Isometry3d>::compose(results[i], batchPoses[i], composed);
+            results[i] = composed;
+        }
+    }
+
+    for(size_t i = 0; i < count; i++)
+    {
+        if(!valid[i])
+            valid[i] = extrapolateChain(times[i], interpolate, results[i]);
+    }
+
+    return updateBatchStatistics(times, count, valid, interpolate);
+}
+
+bool Transformation::getWithCovariance(const base::Time& atTime, Eigen::Isometry3d& pose, PoseCovariance& covariance, bool interpolate) const
+{
+    bool valid;
+    return getWithCovariance(&atTime, 1, &pose, &covariance, &valid, interpolate) == 1;
+}
+
+size_t Transformation::getWithCovariance(const base::Time* times, size_t count, Eigen::Isometry3d* poses, PoseCovariance* covariances, bool* valid, bool interpolate) const
+{
+    if(!this->valid)
+    {
+        std::fill(valid, valid + count, false);
+        failedNoChain += count;
+        return 0;
+    }
+
+    std::fill(valid, valid + count, true);
+    for(size_t i = 0; i < count; i++)
+    {
+        poses[i].setIdentity();
+        covariances[i].setZero();
+    }
+
+    //the chain is walked edge by edge in all modes, as neither the segments
+    //nor the tree cache keep the covariances
+    batchPoses.resize(count);
+    batchCovariances.resize(count);
+    Eigen::Isometry3d composed;
+    PoseCovariance composedCovariance;
+    for(std::vector<TransformationEdge>::const_iterator it = transformationChain.begin(); it != transformationChain.end(); it++)
+    {
+        it->element->getPosesWithCovariance(times, count, interpolate, &batchPoses[0], &batchCovariances[0], valid);
+        for(size_t i = 0; i < count; i++)
+        {
+            if(!valid[i])
+                continue;
+            if(it->inverse)
+                invertWithCovariance(batchPoses[i], batchCovariances[i]);
+            if(it == transformationChain.begin())
+            {
+                poses[i] = batchPoses[i];
+                covariances[i] = batchCovariances[i];
+                continue;
+            }
+            composeWithCovariance(poses[i], covariances[i], batchPoses[i], batchCovariances[i], composed, composedCovariance);
+            poses[i] = composed;
+            covariances[i] = composedCovariance;
+        }
+    }
+
+    return updateBatchStatistics(times, count, valid, interpolate);
+}
+
+size_t Transformation::updateBatchStatistics(const base::Time* times, size_t count, const bool* valid, bool interpolate) const
+{
+    size_t validCount = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        if(valid[i])
+        {
+            validCount++;
+            lastGeneratedValue = times[i];
+        }
+        else if (interpolate)
+            failedInterpolationImpossible++;
+        else
+            failedNoSample++;
+    }
+    generatedTransformations += validCount;
+    return validCount;
+}
+
+bool Transformation::extrapolateChain(const base::Time& atTime, bool interpolate, Eigen::Isometry3d& result) const
+{
+    if(extrapolation.mode == ExtrapolationPolicy::NONE)
+        return false;
+
+    bool extrapolated = false;
+    Eigen::Isometry3d pose;
+    Eigen::Isometry3d composed;
+    result.setIdentity();
+    for(std::vector<TransformationEdge>::const_iterator it = transformationChain.begin(); it != transformationChain.end(); it++)
+    {
+        bool elementExtrapolated;
+        if(!it->element->getExtrapolatedPose(atTime, interpolate, extrapolation, pose, elementExtrapolated))
+            return false;
+        extrapolated |= elementExtrapolated;
+        if(it->inverse)
+            pose = pose.inverse(Eigen::Isometry);
+        CompositionTraits<Eigen::Isometry3d>::compose(result, pose, composed);
+        result = composed;
+    }
+
+    if(extrapolated)
+        extrapolatedTransformations++;
+    return true;
+}
+
+bool Transformation::getFromTreeCache(const base::Time& atTime, Eigen::Affine3d& result, bool interpolate) const
+{
+    if(treeCache->get(sourceFrameId, targetFrameId, atTime, interpolate, result))
+        return true;
+
+    Eigen::Isometry3d extrapolated;
+    if(extrapolateChain(atTime, interpolate, extrapolated))
+    {
+        result.matrix() = extrapolated.matrix();
+        return true;
+    }
+
+    if (interpolate)
+        failedInterpolationImpossible++;
+    else
+        failedNoSample++;
+    return false;
+}
+
+bool Transformation::evaluate(const base::Time& atTime, bool interpolate, Eigen::Isometry3d& result) const
+{
+    if (treeCache)
+    {
+        Eigen::Affine3d tr;
+        if(!getFromTreeCache(atTime, tr, interpolate))
+            return false;
+        result.matrix() = tr.matrix();
+        return true;
+    }
+
+    if (staticChain)
+    {
+        if (staticTransformDirty)
+            updateStaticTransform();
+        result = staticTransform;
+        return true;
+    }
+
+    return evaluateSegments(atTime, interpolate, result);
+}
+
+bool Transformation::evaluate(const base::Time& atTime, bool interpolate, Eigen::Affine3d& result) const
+{
+    if (treeCache)
+        return getFromTreeCache(atTime, result, interpolate);
+
+    Eigen::Isometry3d pose;
+    if(!evaluate(atTime, interpolate, pose))
+        return false;
+    result.matrix() = pose.matrix();
+    return true;
+}
+
+bool Transformation::getSampleTimeAfter(const base::Time& time, base::Time& sampleTime) const
+{
+    bool found = false;
+    base::Time elementTime;
+    for(std::vector<TransformationEdge>::const_iterator it = transformationChain.begin(); it != transformationChain.end(); it++)
+    {
+        if(it->element->getSampleTimeAfter(time, elementTime) && (!found || elementTime < sampleTime))
+        {
+            sampleTime = elementTime;
+            found = true;
+        }
+    }
+    return found;
+}
+
+TransformationSampleIterator::TransformationSampleIterator(const Transformation& transformation, const base::Time& start, const base::Time& end, bool interpolate)
+    : transformation(transformation)
+    , end(end)
+    , interpolate(interpolate)
+    , time(start - base::Time::fromMicroseconds(1))
+{
+    pose.setIdentity();
+}
+
+bool TransformationSampleIterator::next()
+{
+    base::Time sampleTime;
+    Eigen::Affine3d value;
+    while(transformation.getSampleTimeAfter(time, sampleTime) && sampleTime <= end)
+    {
+        time = sampleTime;
+        if(transformation.get(time, value, interpolate))
+        {
+            pose.matrix() = value.matrix();
+            return true;
+        }
+    }
+    //stay at the end of the window
+    time = end;
+    return false;
+}
+
+bool Transformation::usesElement(const TransformationElement* element) const
+{
+    for(std::vector< TransformationEdge >::const_iterator it = transformationChain.begin();
+        it != transformationChain.end(); it++)
+    {
+        if(it->element == element)
+            return true;
+    }
+    return false;
+}
+
+void Transformation::removeChainCallbacks()
+{
+    for(std::vector< TransformationEdge >::iterator it = transformationChain.begin();
+        it != transformationChain.end(); it++)
+    {
+        it->element->removeTransformationChangedCallbacks(this);
+    }
+}
+
 void Transformation::registerUpdateCallback(boost::function<void (const base::Time &ts)> callback)
 {
     transformationChangedCallback = callback;
     
     if(valid)
     {
-	for(std::vector< TransformationElement* >::iterator it = transformationChain.begin();
-	it != transformationChain.end(); it++)
-	{
-	    (*it)->addTransformationChangedCallback(transformationChangedCallback);
-	}
+        removeChainCallbacks();
+        registerChainCallbacks();
     }
 }
 
-class TransformationNode {
-    public:
-	TransformationNode() : parent(NULL) {};
-	TransformationNode(const std::string &frameName, TransformationNode *parent, TransformationElement *parentToCurNode) : frameName(frameName), parent(parent), parentToCurNode(parentToCurNode) {};
-	
-	std::string frameName;
-	TransformationNode *parent;
-	TransformationElement *parentToCurNode;
-	std::vector<TransformationNode *> childs;
-	~TransformationNode() {
-	    //delete all known childs
-	    for(std::vector<TransformationNode *>::iterator it = childs.begin(); it != childs.end(); it++) {
-		delete *it;
-	    }
-	    childs.clear();
-	}
-};
+void TransformationElement::notifyTransformationChanged(const base::Time& ts)
+{
+    version++;
+    for(std::vector<boost::function<void (const base::Time &ts)> >::const_iterator it = elementChangedCallbacks.begin();
+    it != elementChangedCallbacks.end(); it++)
+    {
+	(*it)(ts);
+    }
+}
+
+void TransformationElement::removeTransformationChangedCallbacks(const void* owner)
+{
+    size_t kept = 0;
+    for(size_t i = 0; i < elementChangedCallbacks.size(); i++)
+    {
+        if(elementChangedCallbackOwners[i] == owner)
+            continue;
+
+        if(kept != i)
+        {
+            elementChangedCallbacks[kept] = elementChangedCallbacks[i];
+            elementChangedCallbackOwners[kept] = elementChangedCallbackOwners[i];
+        }
+        kept++;
+    }
+    elementChangedCallbacks.resize(kept);
+    elementChangedCallbackOwners.resize(kept);
+}
 
 TransformationTree::~TransformationTree()
 {
@@ -100,12 +582,7 @@ std::pair<int, int> TransformationTree::getElementsCount() const
     int static_count = 0, dynamic_count = 0;
     for(std::vector< TransformationElement* >::const_iterator it = availableElements.begin(); it != availableElements.end(); it++)
     {
-        TransformationElement const* element = *it;
-        InverseTransformationElement const* inv_element = dynamic_cast<InverseTransformationElement const*>(*it);
-        if (inv_element)
-            element = inv_element->getElement();
-
-        if (dynamic_cast<DynamicTransformationElement const*>(element))
+        if (dynamic_cast<DynamicTransformationElement const*>(*it))
             dynamic_count++;
         else
             static_count++;
@@ -117,247 +594,651 @@ void TransformationTree::dumpTree() const
 {
     for(std::vector< TransformationElement* >::const_iterator it = availableElements.begin(); it != availableElements.end(); it++)
     {
-        TransformationElement const* element = *it;
-        bool is_inv = false, is_dyn = false;
+        if (dynamic_cast<DynamicTransformationElement const*>(*it))
+            LOG_DEBUG_S << "(dyn) " << (*it)->getSourceFrame() << " <> " << (*it)->getTargetFrame() << std::endl;
+        else
+            LOG_DEBUG_S << "(static) " << (*it)->getSourceFrame() << " <> " << (*it)->getTargetFrame() << std::endl;
+    }
+}
 
-        InverseTransformationElement const* inv_element = dynamic_cast<InverseTransformationElement const*>(*it);
-        if (inv_element)
-        {
-            is_inv = true;
-            element = inv_element->getElement();
-        }
+FrameId TransformationTree::getFrameId(const std::string& frameName)
+{
+    std::map<std::string, FrameId>::const_iterator it = frameIds.find(frameName);
+    if(it != frameIds.end())
+        return it->second;
 
-        if (dynamic_cast<DynamicTransformationElement const*>(element))
-            is_dyn = true;
+    FrameId id = frameNames.size();
+    frameIds.insert(std::make_pair(frameName, id));
+    frameNames.push_back(frameName);
+    adjacency.resize(frameNames.size());
+    componentParents.push_back(id);
+    return id;
+}
 
+bool TransformationTree::findFrameId(const std::string& frameName, FrameId& id) const
+{
+    std::map<std::string, FrameId>::const_iterator it = frameIds.find(frameName);
+    if(it == frameIds.end())
+        return false;
 
-        if (is_inv)
-        {
-            if (is_dyn)
-                LOG_DEBUG_S << "(inv,dyn) " << inv_element->getSourceFrame() << " > " << inv_element->getTargetFrame() << std::endl;
-            else
-                LOG_DEBUG_S << "(inv,static) " << inv_element->getSourceFrame() << " > " << inv_element->getTargetFrame() << std::endl;
-        }
-        else
-        {
-            if (is_dyn)
-                LOG_DEBUG_S << "(dyn) " << element->getSourceFrame() << " > " << element->getTargetFrame() << std::endl;
-            else
-                LOG_DEBUG_S << "(static) " << element->getSourceFrame() << " > " << element->getTargetFrame() << std::endl;
-        }
+    id = it->second;
+    return true;
+}
+
+FrameId TransformationTree::getComponent(FrameId frame) const
+{
+    FrameId root = frame;
+    while(componentParents[root] != root)
+        root = componentParents[root];
+
+    //path compression
+    while(componentParents[frame] != root)
+    {
+        FrameId next = componentParents[frame];
+        componentParents[frame] = root;
+        frame = next;
     }
+    return root;
 }
 
 void TransformationTree::addTransformation(TransformationElement* element)
 {
+    FrameId source = getFrameId(element->getSourceFrame());
+    FrameId target = getFrameId(element->getTargetFrame());
+
     //add transformation
     availableElements.push_back(element);
+    adjacency[source].push_back(TransformationEdge(element, false, target));
     
     //and it's inverse
-    TransformationElement *inverse = new InverseTransformationElement(element);
-    availableElements.push_back(inverse);
-    
+    adjacency[target].push_back(TransformationEdge(element, true, source));
+
+    //merge the components of source and target
+    FrameId sourceComponent = getComponent(source);
+    FrameId targetComponent = getComponent(target);
+    if(sourceComponent != targetComponent)
+        componentParents[sourceComponent] = targetComponent;
 }
 
-void TransformationTree::addMatchingTransforms(std::string from, TransformationNode *node)
+void TransformationTree::removeTransformation(TransformationElement* element)
 {
-    for(std::vector< TransformationElement* >::const_iterator it = availableElements.begin(); it != availableElements.end(); it++)
+    std::vector<TransformationElement *>::iterator it = std::find(availableElements.begin(), availableElements.end(), element);
+    if(it == availableElements.end())
+        throw std::runtime_error("Tried to remove a transformation element that is not part of the tree");
+    availableElements.erase(it);
+
+    FrameId frames[2] = { getFrameId(element->getSourceFrame()), getFrameId(element->getTargetFrame()) };
+    for(int i = 0; i < 2; i++)
     {
-	if((*it)->getSourceFrame() == from)
-	{
-	    //security check for not building A->B->A->B loops
-	    if(node->parent && node->parent->frameName == (*it)->getTargetFrame())
-		continue;
-	    
-	    node->childs.push_back(new TransformationNode((*it)->getTargetFrame(), node, *it));
-	}	
+        std::vector<TransformationEdge> &edges(adjacency[frames[i]]);
+        for(size_t j = 0; j < edges.size(); )
+        {
+            if(edges[j].element == element)
+                edges.erase(edges.begin() + j);
+            else
+                j++;
+        }
+    }
+    delete element;
+
+    //the removal might have split a component, rebuild them all
+    for(size_t i = 0; i < componentParents.size(); i++)
+        componentParents[i] = i;
+    for(FrameId frame = 0; frame < (FrameId)adjacency.size(); frame++)
+    {
+        const std::vector<TransformationEdge> &edges(adjacency[frame]);
+        for(std::vector<TransformationEdge>::const_iterator edge = edges.begin(); edge != edges.end(); edge++)
+        {
+            FrameId sourceComponent = getComponent(frame);
+            FrameId targetComponent = getComponent(edge->target);
+            if(sourceComponent != targetComponent)
+                componentParents[sourceComponent] = targetComponent;
+        }
     }
 }
 
-std::vector< TransformationNode* >::const_iterator TransformationTree::checkForMatchingChildFrame(const std::string& to, const transformer::TransformationNode& node)
+bool TransformationTree::getTransformationChain(const std::string& from, const std::string& to, std::vector< TransformationEdge >& result)
 {
-    for(std::vector<TransformationNode *>::const_iterator it = node.childs.begin(); it != node.childs.end(); it++)
+    return getTransformationChain(getFrameId(from), getFrameId(to), result);
+}
+
+void TransformationTree::prepareSearch()
+{
+    size_t frameCount = frameNames.size();
+    for(int direction = 0; direction < 2; direction++)
     {
-	if((*it)->frameName == to)
-	    return it;
+        if(searchMarks[direction].size() < frameCount)
+        {
+            searchMarks[direction].resize(frameCount, 0);
+            searchDepths[direction].resize(frameCount, 0);
+            searchParents[direction].resize(frameCount, -1);
+            searchEdges[direction].resize(frameCount, TransformationEdge(NULL, false, -1));
+            searchQueues[direction].reserve(frameCount);
+        }
+        searchQueues[direction].clear();
+    }
+
+    searchId++;
+    if(searchId == 0)
+    {
+        //the marks wrapped around, forget all old ones
+        for(int direction = 0; direction < 2; direction++)
+            std::fill(searchMarks[direction].begin(), searchMarks[direction].end(), 0);
+        searchId = 1;
     }
-    
-    return node.childs.end();
 }
 
+FrameId TransformationTree::expandSearchLevel(int direction, size_t &head)
+{
+    std::vector<unsigned> &marks(searchMarks[direction]);
+    std::vector<int> &depths(searchDepths[direction]);
+    std::vector<FrameId> &parents(searchParents[direction]);
+    std::vector<TransformationEdge> &edges(searchEdges[direction]);
+    std::vector<FrameId> &queue(searchQueues[direction]);
+    const std::vector<unsigned> &otherMarks(searchMarks[1 - direction]);
+    const std::vector<int> &otherDepths(searchDepths[1 - direction]);
 
-bool TransformationTree::getTransformationChain(std::string from, std::string to, std::vector< TransformationElement* >& result)
+    FrameId meeting = -1;
+    int meetingLength = 0;
+    size_t levelEnd = queue.size();
+    for(; head < levelEnd; head++)
+    {
+        FrameId frame = queue[head];
+        const std::vector<TransformationEdge> &outgoing(adjacency[frame]);
+        for(std::vector<TransformationEdge>::const_iterator it = outgoing.begin(); it != outgoing.end(); it++)
+        {
+            FrameId next = it->target;
+            if(marks[next] == searchId)
+                continue;
+
+            marks[next] = searchId;
+            depths[next] = depths[frame] + 1;
+            parents[next] = frame;
+            if(direction == 0)
+                edges[next] = *it;
+            else
+                //the chain goes from next to frame
+                edges[next] = TransformationEdge(it->element, !it->inverse, frame);
+            queue.push_back(next);
+
+            if(otherMarks[next] == searchId)
+            {
+                int length = depths[next] + otherDepths[next];
+                if(meeting == -1 || length < meetingLength)
+                {
+                    meeting = next;
+                    meetingLength = length;
+                }
+            }
+        }
+    }
+    return meeting;
+}
+
+bool TransformationTree::getCheapestTransformationChain(FrameId from, FrameId to, std::vector< TransformationEdge >& result)
+{
+    std::vector<unsigned> &marks(searchMarks[0]);
+    std::vector<int> &depths(searchDepths[0]);
+    std::vector<FrameId> &parents(searchParents[0]);
+    std::vector<TransformationEdge> &edges(searchEdges[0]);
+    //marks in the backward direction flag the frames that are done
+    std::vector<unsigned> &done(searchMarks[1]);
+    if(searchCosts.size() < marks.size())
+        searchCosts.resize(marks.size(), 0);
+
+    searchHeap.clear();
+    marks[from] = searchId;
+    depths[from] = 0;
+    searchCosts[from] = 0;
+    searchHeap.push_back(std::make_pair(std::make_pair(0.0, 0), from));
+
+    while(!searchHeap.empty())
+    {
+        std::pop_heap(searchHeap.begin(), searchHeap.end(), std::greater< std::pair< std::pair<double, int>, FrameId > >());
+        std::pair< std::pair<double, int>, FrameId > top(searchHeap.back());
+        searchHeap.pop_back();
+
+        FrameId frame = top.second;
+        if(done[frame] == searchId)
+            continue;
+        done[frame] = searchId;
+        if(frame == to)
+            break;
+
+        if(depths[frame] >= maxSeekDepth)
+            continue;
+
+        const std::vector<TransformationEdge> &outgoing(adjacency[frame]);
+        for(std::vector<TransformationEdge>::const_iterator it = outgoing.begin(); it != outgoing.end(); it++)
+        {
+            FrameId next = it->target;
+            if(done[next] == searchId)
+                continue;
+
+            std::pair<double, int> cost(searchCosts[frame] + it->element->getCost(), depths[frame] + 1);
+            if(marks[next] == searchId && std::make_pair(searchCosts[next], depths[next]) <= cost)
+                continue;
+
+            marks[next] = searchId;
+            searchCosts[next] = cost.first;
+            depths[next] = cost.second;
+            parents[next] = frame;
+            edges[next] = *it;
+            searchHeap.push_back(std::make_pair(cost, next));
+            std::push_heap(searchHeap.begin(), searchHeap.end(), std::greater< std::pair< std::pair<double, int>, FrameId > >());
+        }
+    }
+
+    if(done[to] != searchId)
+    {
+        LOG_DEBUG_S << "could not find result for " << frameNames[from] << " " << frameNames[to];
+        return false;
+    }
+
+    LOG_DEBUG_S << "Found Transformation chain from " << frameNames[from] << " to " << frameNames[to] << " with cost " << searchCosts[to];
+
+    result.clear();
+    for(FrameId cur = to; cur != from; cur = parents[cur])
+        result.push_back(edges[cur]);
+    return true;
+}
+
+bool TransformationTree::getTransformationChain(FrameId from, FrameId to, std::vector< TransformationEdge >& result)
 {
     if (from == to)
         return true;
 
-    TransformationNode node(from, NULL, NULL);
-    
-    std::vector<TransformationNode *> curLevel;
-    curLevel.push_back(&node);
+    prepareSearch();
+    if(costBasedSelection)
+        return getCheapestTransformationChain(from, to, result);
     
-    for(int i = 0; i < maxSeekDepth && curLevel.size(); i++) {
-	std::vector<TransformationNode *> nextLevel;
+    FrameId starts[2] = { from, to };
+    size_t heads[2] = { 0, 0 };
+    int levels[2] = { 0, 0 };
+    for(int direction = 0; direction < 2; direction++)
+    {
+        searchMarks[direction][starts[direction]] = searchId;
+        searchDepths[direction][starts[direction]] = 0;
+        searchQueues[direction].push_back(starts[direction]);
+    }
 
-	for(std::vector<TransformationNode *>::iterator it = curLevel.begin(); it != curLevel.end(); it++)
-	{
-	    //expand tree node
-	    addMatchingTransforms((*it)->frameName, *it);
-	    
-	    //check if a child of the node matches the wanted frame
-	    std::vector< TransformationNode* >::const_iterator candidate = checkForMatchingChildFrame(to, **it);
-	    if(candidate != (*it)->childs.end())
-	    {
-		LOG_DEBUG_S << "Found Transformation chain from " << from << " to " << to;
-                LOG_DEBUG_S << "Chain is (reverse) : ";
-		
-		TransformationNode *curNode = *candidate;
-		result.reserve(i + 1);
-		
-		//found a valid transformation
-		while(curNode->parent)
-		{
-		    result.push_back(curNode->parentToCurNode);
-		    LOG_DEBUG_S << "   " << curNode->frameName << " " << curNode->parentToCurNode->getTargetFrame() << "<->" << curNode->parentToCurNode->getSourceFrame();
-		    
-		    curNode = curNode->parent;
-		}
-		LOG_DEBUG_S << "   " << curNode->frameName << std::endl;
-		
-		return true;
-	    }
-	    
-	    //add childs of current level to search area for next level
-	    nextLevel.insert(nextLevel.end(), (*it)->childs.begin(), (*it)->childs.end());
-	}
-	
-	curLevel = nextLevel;
+    FrameId meeting = -1;
+    while(levels[0] + levels[1] < maxSeekDepth)
+    {
+        size_t forwardFrontier = searchQueues[0].size() - heads[0];
+        size_t backwardFrontier = searchQueues[1].size() - heads[1];
+        if(!forwardFrontier || !backwardFrontier)
+            break;
+
+        //always grow the smaller frontier
+        int direction = (forwardFrontier <= backwardFrontier) ? 0 : 1;
+        meeting = expandSearchLevel(direction, heads[direction]);
+        levels[direction]++;
+        if(meeting != -1)
+            break;
     }
-    
-    LOG_DEBUG_S << "could not find result for " << from << " " << to;
 
+    if(meeting == -1)
+    {
+        LOG_DEBUG_S << "could not find result for " << frameNames[from] << " " << frameNames[to];
+        return false;
+    }
+
+    LOG_DEBUG_S << "Found Transformation chain from " << frameNames[from] << " to " << frameNames[to];
+
+    //the chain is stored starting at the target frame. First the part
+    //between the meeting point and the target ...
+    result.clear();
+    for(FrameId cur = meeting; cur != to; cur = searchParents[1][cur])
+        result.push_back(searchEdges[1][cur]);
+    std::reverse(result.begin(), result.end());
+
+    //... then the part between the source and the meeting point
+    for(FrameId cur = meeting; cur != from; cur = searchParents[0][cur])
+        result.push_back(searchEdges[0][cur]);
+
+    return true;
+}
+
+TransformationElement const* InverseTransformationElement::getElement() const
+{
+    return nonInverseElement;
+}
+
+TransformationElement* InverseTransformationElement::getElement()
+{
+    return nonInverseElement;
+}
+
+bool InverseTransformationElement::getTransformation(const base::Time& atTime, bool doInterpolation, transformer::TransformationType& tr)
+{
+    if(nonInverseElement->getTransformation(atTime, doInterpolation, tr)){
+	invertTransformation(tr);
+	return true;
+    }
     return false;
+};
+
+bool InverseTransformationElement::getPose(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose)
+{
+    unsigned currentVersion = nonInverseElement->getVersion();
+    if(cacheValid && cachedVersion == currentVersion && cachedTime == atTime && cachedInterpolation == doInterpolation)
+    {
+        pose = cachedPose;
+        return true;
+    }
+
+    if(!nonInverseElement->getPose(atTime, doInterpolation, pose))
+        return false;
+    pose = pose.inverse(Eigen::Isometry);
+
+    cacheValid = true;
+    cachedVersion = currentVersion;
+    cachedTime = atTime;
+    cachedInterpolation = doInterpolation;
+    cachedPose = pose;
+    return true;
+}
+
+bool InverseTransformationElement::getPoseWithCovariance(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose, PoseCovariance& covariance)
+{
+    if(!nonInverseElement->getPoseWithCovariance(atTime, doInterpolation, pose, covariance))
+        return false;
+    invertWithCovariance(pose, covariance);
+    return true;
+}
+
+bool InverseTransformationElement::getExtrapolatedPose(const base::Time& atTime, bool doInterpolation, const ExtrapolationPolicy& policy, Eigen::Isometry3d& pose, bool& extrapolated)
+{
+    if(!nonInverseElement->getExtrapolatedPose(atTime, doInterpolation, policy, pose, extrapolated))
+        return false;
+    pose = pose.inverse(Eigen::Isometry);
+    return true;
+}
+
+DynamicTransformationElement::DynamicTransformationElement(const std::string& sourceFrame, const std::string& targetFrame, aggregator::StreamAligner& aggregator, int priority, size_t historySize)
+    : TransformationElement(sourceFrame, targetFrame), aggregator(aggregator), history(historySize), gotNextSample(false), period(0), latency(0)
+{
+    //giving a buffersize of zero means no buffer limitation at all
+    //giving a period of zero means, block until next sample is available
+    streamIdx = aggregator.registerStream<TransformationType>(
+	    boost::bind( &transformer::DynamicTransformationElement::aggregatorCallback , this, _1, _2 ), 
+	    0, base::Time(), priority, sourceFrame + std::string("2") + targetFrame);
+}
+
+DynamicTransformationElement::~DynamicTransformationElement()
+{
+    aggregator.unregisterStream(streamIdx);
+}
+
+void DynamicTransformationElement::updateStatistics(const base::Time& ts, const base::Time& latestTime)
+{
+    //weight of a new measurement in the moving averages
+    static const double alpha = 0.1;
+
+    double sampleLatency = (latestTime - ts).toSeconds();
+    if(lastPushedTime.isNull())
+        latency = sampleLatency;
+    else
+    {
+        latency += alpha * (sampleLatency - latency);
+        double samplePeriod = (ts - lastPushedTime).toSeconds();
+        if(samplePeriod > 0)
+        {
+            if(period == 0)
+                period = samplePeriod;
+            else
+                period += alpha * (samplePeriod - period);
+        }
+    }
+    lastPushedTime = ts;
+}
+
+void DynamicTransformationElement::aggregatorCallback(const base::Time& ts, const transformer::TransformationType& value)
+{
+    lastTransform = value;
+    history.push(ts, value);
+    notifyTransformationChanged(ts);
+}
+
+void interpolatePose(const Eigen::Quaterniond &startOrientation, const Eigen::Vector3d &startPosition,
+        const Eigen::Quaterniond &endOrientation, const Eigen::Vector3d &endPosition, double factor, Eigen::Isometry3d &pose)
+{
+    pose.linear() = startOrientation.slerp(factor, endOrientation).toRotationMatrix();
+    pose.translation() = (1.0-factor) * startPosition + factor * endPosition;
+    pose.makeAffine();
+}
+
+bool DynamicTransformationElement::lookup(const base::Time& atTime, bool doInterpolation, bool reuseNextSample, size_t& index, bool& interpolated, double& factor)
+{
+    if(!history.find(atTime, index))
+        return false;
+
+    interpolated = false;
+    base::Time startTime = history.getTime(index);
+    if(!doInterpolation || atTime == startTime)
+        return true;
+
+    base::Time endTime;
+    if(index + 1 < history.size())
+        endTime = history.getTime(index + 1);
+    else
+    {
+        if(!reuseNextSample)
+            gotNextSample = aggregator.getNextSample(streamIdx, nextSample);
+        if(!gotNextSample)
+        {
+            //not enought samples for itnerpolation available
+            return false;
+        }
+        endTime = nextSample.first;
+    }
+
+    double timeForward = (atTime - startTime).toSeconds();
+    double timeBetweenTransforms = (endTime - startTime).toSeconds();
+    if(timeForward >= timeBetweenTransforms)
+        return false;
+
+    interpolated = true;
+    factor = timeForward / timeBetweenTransforms;
+    return true;
 }
 
-TransformationElement const* InverseTransformationElement::getElement() const
+void DynamicTransformationElement::evaluatePose(size_t index, bool interpolated, double factor, Eigen::Isometry3d& pose) const
 {
-    return nonInverseElement;
+    if(!interpolated)
+        history.getPose(index, pose);
+    else if(index + 1 < history.size())
+        interpolatePose(history.getOrientation(index), history.getPosition(index),
+                history.getOrientation(index + 1), history.getPosition(index + 1), factor, pose);
+    else
+        interpolatePose(history.getOrientation(index), history.getPosition(index),
+                nextSample.second.orientation, nextSample.second.position, factor, pose);
 }
 
-TransformationElement* InverseTransformationElement::getElement()
+bool extrapolatePose(const PoseHistory& history, const TransformationType& latest, const base::Time& atTime,
+        const ExtrapolationPolicy& policy, Eigen::Isometry3d& pose)
 {
-    return nonInverseElement;
-}
+    if(policy.mode == ExtrapolationPolicy::NONE || history.empty())
+        return false;
 
-bool InverseTransformationElement::getTransformation(const base::Time& atTime, bool doInterpolation, transformer::TransformationType& tr)
-{
-    if(nonInverseElement->getTransformation(atTime, doInterpolation, tr)){
-	Eigen::Affine3d tr2(Eigen::Affine3d::Identity());
-	tr2 = tr;
-	tr2 = tr2.inverse();
-	tr.setTransform(tr2);
-        std::swap(tr.sourceFrame, tr.targetFrame);
-	return true;
+    size_t index = history.size() - 1;
+    base::Time latestTime = history.getTime(index);
+    if(atTime <= latestTime || atTime - latestTime > policy.maxHorizon)
+        return false;
+
+    Eigen::Vector3d velocity;
+    Eigen::Vector3d angularVelocity;
+    if(policy.mode == ExtrapolationPolicy::FROM_SAMPLES)
+    {
+        if(history.size() < 2)
+            return false;
+
+        double dt = (latestTime - history.getTime(index - 1)).toSeconds();
+        velocity = (history.getPosition(index) - history.getPosition(index - 1)) / dt;
+        Eigen::AngleAxisd rotation(history.getOrientation(index) * history.getOrientation(index - 1).conjugate());
+        angularVelocity = rotation.axis() * (rotation.angle() / dt);
+    }
+    else
+    {
+        velocity = latest.velocity;
+        angularVelocity = latest.angular_velocity;
+        //unknown velocities are NaN
+        if(!(velocity.array() == velocity.array()).all() || !(angularVelocity.array() == angularVelocity.array()).all())
+            return false;
     }
-    return false;
-};
 
-DynamicTransformationElement::DynamicTransformationElement(const std::string& sourceFrame, const std::string& targetFrame, aggregator::StreamAligner& aggregator, int priority )
-    : TransformationElement(sourceFrame, targetFrame), aggregator(aggregator), gotTransform(false) 
-{
-    //giving a buffersize of zero means no buffer limitation at all
-    //giving a period of zero means, block until next sample is available
-    streamIdx = aggregator.registerStream<TransformationType>(
-	    boost::bind( &transformer::DynamicTransformationElement::aggregatorCallback , this, _1, _2 ), 
-	    0, base::Time(), priority, sourceFrame + std::string("2") + targetFrame);
+    double dt = (atTime - latestTime).toSeconds();
+    double angle = angularVelocity.norm() * dt;
+    Eigen::Quaterniond orientation(history.getOrientation(index));
+    if(angle > 0)
+        orientation = Eigen::AngleAxisd(angle, angularVelocity.normalized()) * orientation;
+    pose.linear() = orientation.toRotationMatrix();
+    pose.translation() = history.getPosition(index) + velocity * dt;
+    pose.makeAffine();
+    return true;
 }
 
-DynamicTransformationElement::~DynamicTransformationElement()
+void DynamicTransformationElement::evaluateCovariance(size_t index, bool interpolated, double factor, PoseCovariance& covariance) const
 {
-    aggregator.unregisterStream(streamIdx);
-}
+    covariance.setZero();
+    covariance.topLeftCorner<3, 3>() = history.getPositionCovariance(index);
+    covariance.bottomRightCorner<3, 3>() = history.getOrientationCovariance(index);
+    if(!interpolated)
+        return;
 
-void DynamicTransformationElement::aggregatorCallback(const base::Time& ts, const transformer::TransformationType& value)
-{
-    gotTransform = true;
-    lastTransform = value;
-    lastTransformTime = ts;
-    for(std::vector<boost::function<void (const base::Time &ts)> >::const_iterator it = elementChangedCallbacks.begin();
-    it != elementChangedCallbacks.end(); it++)
+    // perform linear interpolation of uncertainties
+    PoseCovariance endCovariance;
+    if(index + 1 < history.size())
     {
-	(*it)(ts);
+        endCovariance.setZero();
+        endCovariance.topLeftCorner<3, 3>() = history.getPositionCovariance(index + 1);
+        endCovariance.bottomRightCorner<3, 3>() = history.getOrientationCovariance(index + 1);
     }
+    else
+        toPoseCovariance(nextSample.second, endCovariance);
+    covariance = (1.0-factor) * covariance + factor * endCovariance;
 }
 
 bool DynamicTransformationElement::getTransformation(const base::Time& atTime, bool doInterpolation, transformer::TransformationType& result)
 {
-    if(!gotTransform)
+    size_t index;
+    bool interpolated;
+    double factor;
+    if(!lookup(atTime, doInterpolation, false, index, interpolated, factor))
     {
-	//no sample available, return
-	return false;
+	Eigen::Isometry3d pose;
+	if(!history.getArchivedPose(atTime, pose))
+	    return false;
+
+	//the archive does not keep the covariances
+	result.initSane();
+	result.sourceFrame = getSourceFrame();
+	result.targetFrame = getTargetFrame();
+	result.time = atTime;
+	result.orientation = Eigen::Quaterniond(pose.linear());
+	result.position = pose.translation();
+	result.cov_position.setConstant(std::numeric_limits<double>::quiet_NaN());
+	result.cov_orientation.setConstant(std::numeric_limits<double>::quiet_NaN());
+	return true;
     }
-    
-    if(doInterpolation)
+
+    if(!interpolated && index + 1 == history.size())
     {
-	double timeForward = (atTime - lastTransformTime).toSeconds();
-	
-	if(timeForward < 0) 
-	{
-	    throw std::runtime_error("Error, time of sample is lower than transformation time"); 
-	}
-	
-	if(timeForward == 0) 
-	{
-	    //transform time is equal to sample time, no interpolation needed
-	    result = lastTransform;
+	result = lastTransform;
+	return true;
+    }
 
-	    return true;
-	}
+    Eigen::Isometry3d pose;
+    PoseCovariance covariance;
+    evaluatePose(index, interpolated, factor, pose);
+    evaluateCovariance(index, interpolated, factor, covariance);
 
-	std::pair<base::Time, TransformationType> next_sample;
-	
-	if(!aggregator.getNextSample(streamIdx, next_sample))
-	{
-	    //std::cout << "Transformer: could not get next sample" << std::endl;
-	    //not enought samples for itnerpolation available
-	    return false;
-	}
-	
-	TransformationType interpolated;
-	interpolated.initSane();
+    result.initSane();
+    result.sourceFrame = getSourceFrame();
+    result.targetFrame = getTargetFrame();
+    result.time = interpolated ? atTime : history.getTime(index);
+    result.orientation = Eigen::Quaterniond(pose.linear());
+    result.position = pose.translation();
+    fromPoseCovariance(covariance, result);
+    return true;
+};
 
-	double timeBetweenTransforms = (next_sample.first - lastTransformTime).toSeconds();
+bool DynamicTransformationElement::getPose(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose)
+{
+    size_t index;
+    bool interpolated;
+    double factor;
+    if(!lookup(atTime, doInterpolation, false, index, interpolated, factor))
+	return history.getArchivedPose(atTime, pose);
 
-	assert(timeBetweenTransforms > timeForward);
-	
-	double factor = timeForward / timeBetweenTransforms;
-	
-	Eigen::Quaterniond start_r(lastTransform.orientation);
-	Eigen::Quaterniond end_r(next_sample.second.orientation);
-	
-	interpolated.orientation = (start_r.slerp(factor, end_r));
-	
-	Eigen::Vector3d start_t(lastTransform.position);
-	Eigen::Vector3d end_t(next_sample.second.position);
-	
-	interpolated.position = factor * start_t + (1.0-factor) * end_t; 
+    evaluatePose(index, interpolated, factor, pose);
+    return true;
+}
+
+bool DynamicTransformationElement::getExtrapolatedPose(const base::Time& atTime, bool doInterpolation, const ExtrapolationPolicy& policy, Eigen::Isometry3d& pose, bool& extrapolated)
+{
+    extrapolated = false;
+    if(getPose(atTime, doInterpolation, pose))
+        return true;
 
-	// perform linear interpolation of uncertainties
-	interpolated.cov_position = 
-	    factor * lastTransform.cov_position + 
-	    (1.0-factor) * next_sample.second.cov_position;
+    extrapolated = extrapolatePose(history, lastTransform, atTime, policy, pose);
+    return extrapolated;
+}
 
-	interpolated.cov_orientation = 
-	    factor * lastTransform.cov_orientation + 
-	    (1.0-factor) * next_sample.second.cov_orientation;
+void DynamicTransformationElement::getPoses(const base::Time* times, size_t count, bool doInterpolation, Eigen::Isometry3d* poses, bool* valid)
+{
+    evaluatePoses(times, count, doInterpolation, poses, NULL, valid);
+}
 
-	result = interpolated;
-    } else {
-	result = lastTransform;
-    }
+void DynamicTransformationElement::getPosesWithCovariance(const base::Time* times, size_t count, bool doInterpolation, Eigen::Isometry3d* poses, PoseCovariance* covariances, bool* valid)
+{
+    evaluatePoses(times, count, doInterpolation, poses, covariances, valid);
+}
 
+bool DynamicTransformationElement::getPoseWithCovariance(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose, PoseCovariance& covariance)
+{
+    size_t index;
+    bool interpolated;
+    double factor;
+    if(!lookup(atTime, doInterpolation, false, index, interpolated, factor))
+	return false;
+
+    evaluatePose(index, interpolated, factor, pose);
+    evaluateCovariance(index, interpolated, factor, covariance);
     return true;
-};
+}
+
+void DynamicTransformationElement::evaluatePoses(const base::Time* times, size_t count, bool doInterpolation, Eigen::Isometry3d* poses, PoseCovariance* covariances, bool* valid)
+{
+    //the timestamps are sorted, so the lookups mostly hit the history
+    //cursor, and the next queued sample is fetched at most once
+    bool fetchedNextSample = false;
+    for(size_t i = 0; i < count; i++)
+    {
+        if(!valid[i])
+            continue;
+
+        size_t index;
+        bool interpolated;
+        double factor;
+        bool pastHistory = !history.empty() && times[i] > history.getLatestTime();
+        valid[i] = lookup(times[i], doInterpolation, fetchedNextSample, index, interpolated, factor);
+        if(pastHistory && doInterpolation)
+            fetchedNextSample = true;
+        if(!valid[i])
+        {
+            //the archive does not keep the covariances
+            if(!covariances)
+                valid[i] = history.getArchivedPose(times[i], poses[i]);
+            continue;
+        }
+
+        evaluatePose(index, interpolated, factor, poses[i]);
+        if(covariances)
+            evaluateCovariance(index, interpolated, factor, covariances[i]);
+    }
+}
 
 void TransformationTree::clear()
 {
@@ -367,6 +1248,12 @@ void TransformationTree::clear()
     }
     
     availableElements.clear();
+
+    //frames stay interned, so that ids held by registered transformations stay valid
+    for(std::vector< std::vector<TransformationEdge> >::iterator it = adjacency.begin(); it != adjacency.end(); it++)
+        it->clear();
+    for(size_t i = 0; i < componentParents.size(); i++)
+        componentParents[i] = i;
 }
 
 
@@ -377,6 +1264,18 @@ bool Transformation::get(const base::Time &time, TransformationType& tr, bool do
     tr.targetFrame = targetFrame;
     tr.time = time;
 
+    if(propagateCovariance)
+    {
+	Eigen::Isometry3d pose;
+	PoseCovariance covariance;
+	if(!getWithCovariance(time, pose, covariance, doInterpolation))
+	    return false;
+
+	tr.setTransform(Eigen::Affine3d(pose));
+	fromPoseCovariance(covariance, tr);
+	return true;
+    }
+
     Eigen::Affine3d fullTransformation;
     bool ret = get(time, fullTransformation, doInterpolation);
     if(!ret)
@@ -399,16 +1298,18 @@ bool Transformation::getChain(const base::Time& time, std::vector< Transformatio
     
     int i = 0;
     
-    for(std::vector<TransformationElement *>::const_iterator it = transformationChain.begin(); it != transformationChain.end(); it++)
+    for(std::vector<TransformationEdge>::const_iterator it = transformationChain.begin(); it != transformationChain.end(); it++)
     {
-	tr[i].sourceFrame = (*it)->getSourceFrame();
-	tr[i].targetFrame = (*it)->getTargetFrame();
+	tr[i].sourceFrame = it->element->getSourceFrame();
+	tr[i].targetFrame = it->element->getTargetFrame();
 	tr[i].time = time;
-	if(!(*it)->getTransformation(time, doInterpolation, tr[i]))
+	if(!it->element->getTransformation(time, doInterpolation, tr[i]))
 	{
 	    //no sample available, return
 	    return false;
 	}
+	if(it->inverse)
+	    invertTransformation(tr[i]);
 	
 	i++;
     }
@@ -418,29 +1319,44 @@ bool Transformation::getChain(const base::Time& time, std::vector< Transformatio
 
 bool Transformation::getChain(const base::Time& atTime, std::vector< Eigen::Affine3d >& result, bool interpolate) const
 {
-    std::vector< TransformationType > intern;
-    bool ret = getChain(atTime, intern, interpolate);
-    if(!ret)
+    if(transformationChain.empty()) 
+    {
 	return false;
-    
-    result.resize(intern.size());
+    }
+
+    result.resize(transformationChain.size());
     std::vector<Eigen::Affine3d >::iterator it_out = result.begin();
-    for(std::vector<TransformationType >::const_iterator it = intern.begin(); it != intern.end(); it++)
+    Eigen::Isometry3d pose;
+    for(std::vector<TransformationEdge>::const_iterator it = transformationChain.begin(); it != transformationChain.end(); it++)
     {
-	*it_out = *it;
+	if(!it->element->getPose(atTime, interpolate, pose))
+	{
+	    //no sample available, return
+	    return false;
+	}
+	if(it->inverse)
+	    pose = pose.inverse(Eigen::Isometry);
+	*it_out = pose;
 	it_out++;
     }
     
     return true;
 }
 
-void Transformation::setFrameMapping(const std::string& frameName, const std::string& newName)
+void Transformation::setMappedFrames(FrameId source, const std::string& sourceName, FrameId target, const std::string& targetName)
 {
-    if(sourceFrame == frameName)
-	sourceFrameMapped = newName;
-    
-    if(targetFrame == frameName)
-	targetFrameMapped = newName;
+    sourceFrameId = source;
+    targetFrameId = target;
+
+    if(source == localSourceFrameId)
+        sourceFrameMapped.clear();
+    else
+        sourceFrameMapped = sourceName;
+
+    if(target == localTargetFrameId)
+        targetFrameMapped.clear();
+    else
+        targetFrameMapped = targetName;
 }
 
 
@@ -448,14 +1364,13 @@ Transformation& Transformer::registerTransformation(std::string sourceFrame, std
 {
     Transformation *ret = new Transformation(sourceFrame, targetFrame);
     transformations.push_back(ret);
-    
-    std::vector< TransformationElement* > trChain;
+    ret->localSourceFrameId = transformationTree.getFrameId(sourceFrame);
+    ret->localTargetFrameId = transformationTree.getFrameId(targetFrame);
+    updateFrameIds(*ret);
     
     //check if a transformation chain for this transformation exists
-    if(transformationTree.getTransformationChain(ret->getSourceFrame(), ret->getTargetFrame(), trChain))
-    {
-	ret->setTransformationChain(trChain);
-    }
+    pendingTransformations.push_back(ret);
+    applyTopologyChanges();
     
     return *ret;
 }
@@ -466,31 +1381,190 @@ void Transformer::unregisterTransformation(Transformation* transformation)
     if(it == transformations.end())
         throw std::runtime_error("Tried to unregister non existing transformation");
 
+    transformation->removeChainCallbacks();
     transformations.erase(it);
+    pendingTransformations.erase(std::remove(pendingTransformations.begin(), pendingTransformations.end(), transformation), pendingTransformations.end());
     delete transformation;
 }
 
-void Transformer::recomputeAvailableTransformations()
+bool Transformer::updateFrameIds(Transformation& transformation)
+{
+    FrameId source = getMappedFrameId(transformation.localSourceFrameId);
+    FrameId target = getMappedFrameId(transformation.localTargetFrameId);
+    if(source == transformation.sourceFrameId && target == transformation.targetFrameId)
+        return false;
+
+    transformation.setMappedFrames(source, transformationTree.getFrameName(source),
+            target, transformationTree.getFrameName(target));
+    return true;
+}
+
+void Transformer::resolveTransformation(Transformation& transformation)
 {
-    std::vector<TransformationElement *> &elements(transformationTree.getAvailableElements());
-    //clear all currenty registered callbacks
-    for(std::vector<TransformationElement *>::iterator element = elements.begin(); element != elements.end(); element++)
+    std::vector< TransformationEdge > trChain;
+    bool found;
+    if(treeCache)
+        found = treeCache->getTransformationChain(transformation.sourceFrameId, transformation.targetFrameId, trChain);
+    else
+        found = transformationTree.getTransformationChain(transformation.sourceFrameId, transformation.targetFrameId, trChain);
+
+    transformation.treeCache = treeCache;
+    if(transformation.segmentCache != segmentCache)
     {
-        (*element)->clearTransformationChangedCallbacks();
+        transformation.releaseSegments();
+        transformation.segmentCache = segmentCache;
     }
-    
+    if(found)
+    {
+        transformation.setTransformationChain(trChain);
+    }
+    else
+    {
+        transformation.invalidateChain();
+    }
+}
+
+void Transformer::recomputeAvailableTransformations()
+{
     //seek through all available data streams and update transformation chains
     for(std::vector<Transformation *>::iterator transform = transformations.begin(); transform != transformations.end(); transform++)
     {
-	std::vector< TransformationElement* > trChain;
-	
-	if(transformationTree.getTransformationChain((*transform)->getSourceFrame(), (*transform)->getTargetFrame(), trChain))
-	{
-	    (*transform)->setTransformationChain(trChain);
-	}
+        resolveTransformation(**transform);
     }
 }
 
+void Transformer::addTransformationElement(TransformationElement* element)
+{
+    FrameId source = transformationTree.getFrameId(element->getSourceFrame());
+    FrameId target = transformationTree.getFrameId(element->getTargetFrame());
+    bool closesLoop = transformationTree.getComponent(source) == transformationTree.getComponent(target);
+
+    transformationTree.addTransformation(element);
+    if(treeCache)
+        treeCache->invalidate();
+
+    //a new edge between two components can not shorten a chain that
+    //already existed in one of them, only a loop can
+    if(closesLoop)
+        pendingComponents.push_back(source);
+    applyTopologyChanges();
+}
+
+void Transformer::removeTransformationElement(TransformationElement* element)
+{
+    //chains using the element must forget it before it gets deleted
+    for(std::vector<Transformation *>::iterator it = transformations.begin(); it != transformations.end(); it++)
+    {
+        Transformation &transformation(**it);
+        if(!transformation.usesElement(element))
+            continue;
+
+        transformation.invalidateChain();
+        pendingTransformations.push_back(&transformation);
+    }
+
+    if(treeCache)
+        treeCache->invalidate();
+    plannedCosts.erase(element);
+    transformationTree.removeTransformation(element);
+    applyTopologyChanges();
+}
+
+bool Transformer::removeDynamicTransformation(const std::string& sourceFrame, const std::string& targetFrame)
+{
+    std::pair<FrameId, FrameId> key;
+    if(!transformationTree.findFrameId(sourceFrame, key.first) || !transformationTree.findFrameId(targetFrame, key.second))
+        return false;
+
+    std::map<std::pair<FrameId, FrameId>, DynamicTransformationElement *>::iterator it = dynamicTransformations.find(key);
+    if(it == dynamicTransformations.end())
+        return false;
+
+    LOG_DEBUG_S << "Removing dynamic transformation from " << sourceFrame << " to " << targetFrame;
+
+    DynamicTransformationElement *element = it->second;
+    dynamicTransformations.erase(it);
+    removeTransformationElement(element);
+    return true;
+}
+
+void Transformer::evictIdleTransformations(const base::Time& now)
+{
+    std::vector< std::pair<std::string, std::string> > idle;
+    for(std::map<std::pair<FrameId, FrameId>, DynamicTransformationElement *>::const_iterator it = dynamicTransformations.begin();
+        it != dynamicTransformations.end(); it++)
+    {
+        if(now - it->second->getLastPushedTime() > idleTimeout)
+            idle.push_back(std::make_pair(it->second->getSourceFrame(), it->second->getTargetFrame()));
+    }
+
+    if(idle.empty())
+        return;
+
+    beginTopologyUpdate();
+    for(std::vector< std::pair<std::string, std::string> >::const_iterator it = idle.begin(); it != idle.end(); it++)
+        removeDynamicTransformation(it->first, it->second);
+    commitTopologyUpdate();
+}
+
+void Transformer::checkIdleTransformations()
+{
+    if(idleTimeout.isNull())
+        return;
+
+    if((latestDynamicTime - lastIdleCheck) * 2 < idleTimeout)
+        return;
+
+    lastIdleCheck = latestDynamicTime;
+    evictIdleTransformations(latestDynamicTime);
+}
+
+void Transformer::applyTopologyChanges()
+{
+    if(topologyUpdateDepth)
+        return;
+
+    std::vector<FrameId> components;
+    components.reserve(pendingComponents.size());
+    for(std::vector<FrameId>::const_iterator it = pendingComponents.begin(); it != pendingComponents.end(); it++)
+        components.push_back(transformationTree.getComponent(*it));
+    std::sort(components.begin(), components.end());
+    std::sort(pendingTransformations.begin(), pendingTransformations.end());
+
+    for(std::vector<Transformation *>::iterator it = transformations.begin(); it != transformations.end(); it++)
+    {
+        Transformation &transformation(**it);
+        FrameId component = transformationTree.getComponent(transformation.sourceFrameId);
+        if(std::binary_search(components.begin(), components.end(), component) ||
+            std::binary_search(pendingTransformations.begin(), pendingTransformations.end(), &transformation))
+        {
+            resolveTransformation(transformation);
+        }
+        else if(!transformation.valid && component == transformationTree.getComponent(transformation.targetFrameId))
+        {
+            //the frames just got connected
+            resolveTransformation(transformation);
+        }
+    }
+
+    pendingComponents.clear();
+    pendingTransformations.clear();
+}
+
+void Transformer::beginTopologyUpdate()
+{
+    topologyUpdateDepth++;
+}
+
+void Transformer::commitTopologyUpdate()
+{
+    if(!topologyUpdateDepth)
+        throw std::runtime_error("commitTopologyUpdate called without matching beginTopologyUpdate");
+
+    topologyUpdateDepth--;
+    applyTopologyChanges();
+}
+
 void Transformer::pushDynamicTransformation(const transformer::TransformationType& tr)
 {
     if(tr.sourceFrame == "" || tr.targetFrame == "")
@@ -499,31 +1573,87 @@ void Transformer::pushDynamicTransformation(const transformer::TransformationTyp
     if(tr.time.isNull())
 	throw std::runtime_error("Dynamic transformation without time given (or it is 1970 ;-P)");
 
-    std::map<std::pair<std::string, std::string>, int>::iterator it = transformToStreamIndex.find(std::make_pair(tr.sourceFrame, tr.targetFrame));
+    std::pair<FrameId, FrameId> key(transformationTree.getFrameId(tr.sourceFrame), transformationTree.getFrameId(tr.targetFrame));
+    std::map<std::pair<FrameId, FrameId>, DynamicTransformationElement *>::iterator it = dynamicTransformations.find(key);
     
     //we got an unknown transformation
-    if(it == transformToStreamIndex.end()) {
+    if(it == dynamicTransformations.end()) {
 
 	//create a representation of the dynamic transformation
-	DynamicTransformationElement *dynamicElement = new DynamicTransformationElement(tr.sourceFrame, tr.targetFrame, aggregator, priority);
+	DynamicTransformationElement *dynamicElement = new DynamicTransformationElement(tr.sourceFrame, tr.targetFrame, aggregator, priority, historySize);
+	dynamicElement->configureArchive(archiveDuration, archivePositionTolerance, archiveOrientationTolerance);
 	
-	int streamIdx = dynamicElement->getStreamIdx();
+	dynamicTransformations[key] = dynamicElement;
 	
-	transformToStreamIndex[std::make_pair(tr.sourceFrame, tr.targetFrame)] = streamIdx;
-	
-	LOG_DEBUG_S << "Registering new stream for transformation from " << tr.sourceFrame << " to " << tr.targetFrame << " index is " << streamIdx;
+	LOG_DEBUG_S << "Registering new stream for transformation from " << tr.sourceFrame << " to " << tr.targetFrame << " index is " << dynamicElement->getStreamIdx();
 	
 	//add new dynamic element to transformation tree
-	transformationTree.addTransformation(dynamicElement);
-
-	recomputeAvailableTransformations();
+	addTransformationElement(dynamicElement);
 	
-	it = transformToStreamIndex.find(std::make_pair(tr.sourceFrame, tr.targetFrame));
-	assert(it != transformToStreamIndex.end());
+	it = dynamicTransformations.find(key);
+	assert(it != dynamicTransformations.end());
     }
 
+    if(tr.time > latestDynamicTime)
+        latestDynamicTime = tr.time;
+    it->second->updateStatistics(tr.time, latestDynamicTime);
+    checkCostDrift(it->second);
+
     //push sample
-    aggregator.push(it->second, tr.time, tr);
+    aggregator.push(it->second->getStreamIdx(), tr.time, tr);
+}
+
+void Transformer::setHistorySize(size_t size)
+{
+    historySize = size;
+    for(std::map<std::pair<FrameId, FrameId>, DynamicTransformationElement *>::iterator it = dynamicTransformations.begin(); it != dynamicTransformations.end(); it++)
+        it->second->setHistorySize(size);
+    for(std::vector<JointStateStream *>::iterator it = jointStreams.begin(); it != jointStreams.end(); it++)
+        (*it)->setHistorySize(size);
+}
+
+void Transformer::setHistoryArchive(const base::Time& duration, double positionTolerance, double orientationTolerance)
+{
+    archiveDuration = duration;
+    archivePositionTolerance = positionTolerance;
+    archiveOrientationTolerance = orientationTolerance;
+    for(std::map<std::pair<FrameId, FrameId>, DynamicTransformationElement *>::iterator it = dynamicTransformations.begin(); it != dynamicTransformations.end(); it++)
+        it->second->configureArchive(duration, positionTolerance, orientationTolerance);
+}
+
+void Transformer::checkCostDrift(TransformationElement* element)
+{
+    if(!transformationTree.isCostBasedSelection())
+        return;
+
+    double cost = element->getCost();
+    std::map<TransformationElement *, double>::iterator planned = plannedCosts.find(element);
+    if(planned == plannedCosts.end())
+    {
+        plannedCosts.insert(std::make_pair(element, cost));
+        return;
+    }
+
+    double drift = std::fabs(cost - planned->second);
+    if(drift < minCostDrift || drift < costDriftRatio * planned->second)
+        return;
+
+    LOG_DEBUG_S << "Cost of " << element->getSourceFrame() << " > " << element->getTargetFrame() << " drifted from " << planned->second << " to " << cost << ", re-planning chains";
+    planned->second = cost;
+
+    //any chain in the component might now have a cheaper alternative
+    pendingComponents.push_back(transformationTree.getFrameId(element->getSourceFrame()));
+    applyTopologyChanges();
+}
+
+void Transformer::setCostBasedChainSelection(bool enable)
+{
+    if(enable == transformationTree.isCostBasedSelection())
+        return;
+
+    transformationTree.setCostBasedSelection(enable);
+    plannedCosts.clear();
+    recomputeAvailableTransformations();
 }
 
 void Transformer::pushStaticTransformation(const transformer::TransformationType& tr)
@@ -531,25 +1661,151 @@ void Transformer::pushStaticTransformation(const transformer::TransformationType
     if(tr.sourceFrame == "" || tr.targetFrame == "")
 	throw std::runtime_error("Static transformation with empty target or source frame given");
     
-    transformationTree.addTransformation(new StaticTransformationElement(tr.sourceFrame, tr.targetFrame, tr));
-    recomputeAvailableTransformations();
+    FrameId source = transformationTree.getFrameId(tr.sourceFrame);
+    FrameId target = transformationTree.getFrameId(tr.targetFrame);
+    std::map<std::pair<FrameId, FrameId>, StaticTransformationElement *>::iterator it = staticTransformations.find(std::make_pair(source, target));
+    if(it != staticTransformations.end())
+    {
+        it->second->setTransformation(tr);
+        return;
+    }
+
+    it = staticTransformations.find(std::make_pair(target, source));
+    if(it != staticTransformations.end())
+    {
+        TransformationType inverse(tr);
+        invertTransformation(inverse);
+        it->second->setTransformation(inverse);
+        return;
+    }
+
+    StaticTransformationElement *element = new StaticTransformationElement(tr.sourceFrame, tr.targetFrame, tr);
+    staticTransformations[std::make_pair(source, target)] = element;
+    addTransformationElement(element);
+}
+
+void Transformer::pushTransformationElement(TransformationElement* element)
+{
+    if(element->getSourceFrame() == "" || element->getTargetFrame() == "")
+	throw std::runtime_error("Transformation element with empty target or source frame given");
+
+    addTransformationElement(element);
+}
+
+int Transformer::registerJointStream(const std::vector< JointDescription >& joints, const std::string& name)
+{
+    JointStateStream *stream = new JointStateStream(joints, &aggregator, priority, name, historySize);
+    jointStreams.push_back(stream);
+
+    beginTopologyUpdate();
+    const std::vector<JointTransformationElement *> &elements(stream->getElements());
+    for(std::vector<JointTransformationElement *>::const_iterator it = elements.begin(); it != elements.end(); it++)
+        addTransformationElement(*it);
+    commitTopologyUpdate();
+
+    return jointStreams.size() - 1;
+}
+
+void Transformer::pushJointState(int idx, const base::samples::Joints& joints)
+{
+    if(joints.time.isNull())
+	throw std::runtime_error("Joint state without time given");
+
+    if(joints.time > latestDynamicTime)
+        latestDynamicTime = joints.time;
+    aggregator.push(jointStreams.at(idx)->getStreamIdx(), joints.time, joints);
+}
+
+void Transformer::clearJointStreams()
+{
+    for(std::vector<JointStateStream *>::iterator it = jointStreams.begin(); it != jointStreams.end(); it++)
+        delete *it;
+    jointStreams.clear();
+}
+
+void Transformer::pushStaticTransformations(const std::vector< TransformationType >& transforms)
+{
+    beginTopologyUpdate();
+    try
+    {
+        for(std::vector<TransformationType>::const_iterator it = transforms.begin(); it != transforms.end(); it++)
+            pushStaticTransformation(*it);
+    }
+    catch(...)
+    {
+        commitTopologyUpdate();
+        throw;
+    }
+    commitTopologyUpdate();
 }
 
 void Transformer::setFrameMapping(const std::string& frameName, const std::string& newName)
 {
+    std::map<std::string, std::string> mappings;
+    mappings[frameName] = newName;
+    setFrameMappings(mappings);
+}
+
+void Transformer::setFrameMappings(const std::map< std::string, std::string >& mappings)
+{
+    std::vector<bool> remapped;
+    for(std::map<std::string, std::string>::const_iterator it = mappings.begin(); it != mappings.end(); it++)
+    {
+        FrameId local = transformationTree.getFrameId(it->first);
+        FrameId global = -1;
+        if(!it->second.empty() && it->second != it->first)
+            global = transformationTree.getFrameId(it->second);
+
+        if(frameMappings.size() <= (size_t)local)
+            frameMappings.resize(local + 1, -1);
+        if(frameMappings[local] == global)
+            continue;
+
+        frameMappings[local] = global;
+        if(remapped.size() <= (size_t)local)
+            remapped.resize(local + 1, false);
+        remapped[local] = true;
+    }
+
+    //only transformations that use a remapped frame need a new chain
     for(std::vector<Transformation *>::iterator transform = transformations.begin(); transform != transformations.end(); transform++)
     {
-	(*transform)->setFrameMapping(frameName, newName);
+        FrameId source = (*transform)->localSourceFrameId;
+        FrameId target = (*transform)->localTargetFrameId;
+        bool uses = (source < (FrameId)remapped.size() && remapped[source]) ||
+            (target < (FrameId)remapped.size() && remapped[target]);
+        if(uses && updateFrameIds(**transform))
+            pendingTransformations.push_back(*transform);
     }
-    recomputeAvailableTransformations();
+    applyTopologyChanges();
 }
     
+const double Transformer::costDriftRatio = 0.5;
+const double Transformer::minCostDrift = 0.001;
+
+void Transformer::setTreeMode(bool enable)
+{
+    if(enable == isTreeMode())
+        return;
+
+    if(enable)
+        treeCache = new SpanningTreeCache(transformationTree);
+    else
+    {
+        delete treeCache;
+        treeCache = NULL;
+    }
+    recomputeAvailableTransformations();
+}
+
 void Transformer::addTransformationChain(std::string from, std::string to, const std::vector< TransformationElement* >& chain)
 {
+    FrameId fromId = transformationTree.getFrameId(from);
+    FrameId toId = transformationTree.getFrameId(to);
     for(std::vector<Transformation *>::iterator it = transformations.begin();
 	it != transformations.end(); it++) 
     {
-	if((*it)->getSourceFrame() == from && (*it)->getTargetFrame() == to)
+	if((*it)->sourceFrameId == fromId && (*it)->targetFrameId == toId)
 	{
 	    (*it)->setTransformationChain(chain);
 	}
@@ -580,10 +1836,22 @@ void Transformer::clear()
     }
 
     //clear index mapping
-    transformToStreamIndex.clear();
+    dynamicTransformations.clear();
+    staticTransformations.clear();
+    plannedCosts.clear();
+    latestDynamicTime = base::Time();
+    lastIdleCheck = base::Time();
     
     //clear transformation tree
+    if(treeCache)
+        treeCache->invalidate();
     transformationTree.clear();
+    clearJointStreams();
+
+    //identity transformations stay valid on an empty tree
+    pendingComponents.clear();
+    pendingTransformations.clear();
+    recomputeAvailableTransformations();
     
     transformerStatus.time = base::Time();
     transformerStatus.transformations.clear();
@@ -592,6 +1860,17 @@ void Transformer::clear()
     aggregator.clear();
 }
     
+Transformer::Transformer(int priority)
+    : treeCache( NULL )
+    , segmentCache( new ChainSegmentCache() )
+    , priority( priority )
+    , topologyUpdateDepth( 0 )
+    , historySize( 100 )
+    , archivePositionTolerance( 0 )
+    , archiveOrientationTolerance( 0 )
+{
+}
+
 Transformer::~Transformer()
 {
     for(std::vector<Transformation *>::iterator it = transformations.begin(); it != transformations.end(); it++)
@@ -599,6 +1878,11 @@ Transformer::~Transformer()
 	delete *it;
     }
     transformations.clear();
+    delete treeCache;
+    //the joint elements are deleted by the tree
+    transformationTree.clear();
+    clearJointStreams();
+    delete segmentCache;
 }
     
 }
@@ -9,11 +9,104 @@
 #include <boost/bind.hpp>
 #include <base/samples/rigid_body_state.h>
 #include "TransformationStatus.hpp"
+#include "Composition.hpp"
+#include "CovariancePropagation.hpp"
+#include "PoseHistory.hpp"
+
+namespace base { namespace samples { struct Joints; } }
 
 namespace transformer {
  
 typedef base::samples::RigidBodyState TransformationType;
 class TransformationElement;
+class SpanningTreeCache;
+class ChainSegment;
+class ChainSegmentCache;
+struct JointDescription;
+class JointStateStream;
+
+/**
+ * Integer identifier of a frame. Frame names are interned once by the
+ * TransformationTree, all lookups inside the tree are done on these ids.
+ * */
+typedef int FrameId;
+
+/**
+ * Represents the traversal of a TransformationElement in a given direction.
+ *
+ * Edges are stored in the adjacency lists of the TransformationTree and are
+ * the links of the transformation chains. An edge with inverse set traverses
+ * the element from its target frame to its source frame, i.e. it stands for the
+ * inverse of the element's transformation.
+ * */
+struct TransformationEdge
+{
+    TransformationEdge(TransformationElement *element, bool inverse, FrameId target)
+        : element(element)
+        , inverse(inverse)
+        , target(target) {};
+
+    TransformationElement *element;
+    bool inverse;
+    ///the frame this edge leads to
+    FrameId target;
+};
+
+/**
+ * Replaces the given transformation by its inverse, i.e. inverts the
+ * transformation and swaps source and target frame
+ * */
+void invertTransformation(TransformationType &tr);
+
+/**
+ * Converts the orientation and position of the given transformation into a
+ * rigid body transformation, ignoring all other fields
+ * */
+void toPose(const TransformationType &tr, Eigen::Isometry3d &pose);
+
+/**
+ * Interpolates the pose between two samples, as done by the dynamic
+ * transformation elements. factor is the relative position of the query
+ * time between the two samples.
+ * */
+void interpolatePose(const Eigen::Quaterniond &startOrientation, const Eigen::Vector3d &startPosition,
+	const Eigen::Quaterniond &endOrientation, const Eigen::Vector3d &endPosition, double factor, Eigen::Isometry3d &pose);
+
+/**
+ * Describes how a Transformation answers queries after the latest sample of
+ * a dynamic element of its chain, see Transformation::setExtrapolation
+ * */
+struct ExtrapolationPolicy
+{
+    enum Mode
+    {
+	///such queries fail, the default
+	NONE,
+	///constant velocity, estimated from the two latest samples
+	FROM_SAMPLES,
+	///constant velocity, taken from the velocity and angular_velocity
+	///of the latest sample
+	FROM_VELOCITIES
+    };
+
+    ExtrapolationPolicy(Mode mode = NONE, const base::Time &maxHorizon = base::Time())
+	: mode(mode), maxHorizon(maxHorizon) {};
+
+    Mode mode;
+    ///queries further than this after the latest sample fail
+    base::Time maxHorizon;
+};
+
+/**
+ * Extrapolates the latest sample of a history to atTime according to the
+ * given policy, as done by the dynamic transformation elements.
+ *
+ * @param latest the latest sample, used for its velocities
+ * @return false if atTime is not after the latest sample, is beyond the
+ *   horizon of the policy, or if the velocities are not known
+ * */
+bool extrapolatePose(const PoseHistory &history, const TransformationType &latest, const base::Time &atTime,
+	const ExtrapolationPolicy &policy, Eigen::Isometry3d &pose);
 
 class Transformation
 {
@@ -23,7 +116,18 @@ class Transformation
             : valid(false)
             , sourceFrame(sourceFrame)
             , targetFrame(targetFrame)
+            , localSourceFrameId(-1)
+            , localTargetFrameId(-1)
+            , sourceFrameId(-1)
+            , targetFrameId(-1)
+            , treeCache(NULL)
+            , segmentCache(NULL)
+            , staticChain(false)
+            , staticTransformDirty(false)
+            , propagateCovariance(false)
+            , version(0)
             , generatedTransformations(0)
+            , extrapolatedTransformations(0)
             , failedNoChain(0)
             , failedNoSample(0)
             , failedInterpolationImpossible(0) {};
@@ -33,33 +137,166 @@ class Transformation
 	std::string targetFrame;
 	std::string sourceFrameMapped;
 	std::string targetFrameMapped;
-	std::vector<TransformationElement *> transformationChain;
+	///ids of the local (non-mapped) source and target frame
+	FrameId localSourceFrameId;
+	FrameId localTargetFrameId;
+	///ids of the (mapped) source and target frame in the TransformationTree
+	FrameId sourceFrameId;
+	FrameId targetFrameId;
+	std::vector<TransformationEdge> transformationChain;
+	///if set, transformations are computed by the cache instead of the chain
+	SpanningTreeCache *treeCache;
+
+	///segments of the chain as evaluated by get(), see ChainSegment
+	std::vector<ChainSegment *> segments;
+	///scratch storage for the element poses of the batch get
+	mutable std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> > batchPoses;
+	///scratch storage for the element covariances of getWithCovariance
+	mutable std::vector<PoseCovariance, Eigen::aligned_allocator<PoseCovariance> > batchCovariances;
+	///cache the segments are shared through, NULL if the segments are
+	///owned by this transformation
+	ChainSegmentCache *segmentCache;
+	///true if the whole chain is static. get() then returns staticTransform
+	bool staticChain;
+	///set when a static element of the chain got updated
+	mutable bool staticTransformDirty;
+	mutable Eigen::Isometry3d staticTransform;
+	///see setCovariancePropagation
+	bool propagateCovariance;
+	///see setExtrapolation
+	ExtrapolationPolicy extrapolation;
+
+	///see getVersion
+	unsigned version;
 
         mutable base::Time lastGeneratedValue;
         mutable uint64_t generatedTransformations;
+        mutable uint64_t extrapolatedTransformations;
         mutable uint64_t failedNoChain;
         mutable uint64_t failedNoSample;
         mutable uint64_t failedInterpolationImpossible;
 	boost::function<void (const base::Time &ts)> transformationChangedCallback;
 	
-	void setFrameMapping(const std::string &frameName, const std::string &newName);
+	/**
+	 * Sets the ids and names of the frames the local source and target
+	 * frames are mapped to
+	 * */
+	void setMappedFrames(FrameId source, const std::string &sourceName, FrameId target, const std::string &targetName);
 	
 	/**
 	 * Sets the transformation chain for this transformation
          *
          * The transformation chain is a list of links (represented by
-         * TransformationElement objects) that should be composed to compute the
-         * required transformation
+         * TransformationEdge objects) that should be composed to compute the
+         * required transformation. The first link is the one leading to the
+         * target frame, the last one the one leaving the source frame.
          *
          * Calling this method sets the transformation as valid.
 	 * */
+	void setTransformationChain(const std::vector<TransformationEdge> &chain);
+
+	/**
+	 * Sets a transformation chain given as a list of elements.
+	 *
+	 * InverseTransformationElement objects in the chain are converted into
+	 * inverse edges on the wrapped element.
+	 * */
 	void setTransformationChain(const std::vector<TransformationElement *> &chain);
+
+	/**
+	 * Removes the callbacks this transformation registered on the elements
+	 * of its current chain
+	 * */
+	void removeChainCallbacks();
+
+	/**
+	 * Registers the internal callbacks, and the user callback if there is
+	 * one, on the elements of the current chain
+	 * */
+	void registerChainCallbacks();
+
+	/**
+	 * Called when an element of the chain changes
+	 * */
+	void elementChanged(const base::Time &ts, bool isStatic);
+
+	/**
+	 * Removes the chain and marks the transformation as invalid
+	 * */
+	void invalidateChain();
+
+	/**
+	 * Splits transformationChain into segments, folding consecutive static
+	 * elements into a single segment
+	 * */
+	void buildSegments();
+
+	/**
+	 * Releases the segments of the current chain
+	 * */
+	void releaseSegments();
+
+	/**
+	 * Evaluates the segments for the given query. Segments that did not
+	 * change since they were last evaluated for the same query are not
+	 * evaluated again.
+	 *
+	 * Returns false if a sample is missing
+	 * */
+	bool evaluateSegments(const base::Time &atTime, bool interpolate, Eigen::Isometry3d &result) const;
+
+	/**
+	 * Recomputes staticTransform from the segment of an all static chain
+	 * */
+	void updateStaticTransform() const;
+
+	/**
+	 * Updates the statistics after a batch query
+	 * */
+	size_t updateBatchStatistics(const base::Time *times, size_t count, const bool *valid, bool interpolate) const;
+
+	/**
+	 * Computes the transformation edge by edge, extrapolating the
+	 * elements that have no sample for the query. Called when the normal
+	 * evaluation failed.
+	 *
+	 * Returns false if extrapolation is disabled or not possible
+	 * */
+	bool extrapolateChain(const base::Time &atTime, bool interpolate, Eigen::Isometry3d &result) const;
+
+	/**
+	 * Returns true if the given element is part of the current chain
+	 * */
+	bool usesElement(const TransformationElement *element) const;
+
+	/**
+	 * Computes the transformation using treeCache
+	 * */
+	bool getFromTreeCache(const base::Time &atTime, Eigen::Affine3d &result, bool interpolate) const;
+
+	/**
+	 * Computes the transformation for get, using the tree cache, the
+	 * static transform or the segments. Failures are counted.
+	 * */
+	bool evaluate(const base::Time &atTime, bool interpolate, Eigen::Isometry3d &result) const;
+	bool evaluate(const base::Time &atTime, bool interpolate, Eigen::Affine3d &result) const;
+
+	/**
+	 * Computes the transformation for get, composing the edges with
+	 * CompositionTraits<T>
+	 * */
+	template <class T>
+	bool evaluate(const base::Time &atTime, bool interpolate, T &result) const;
 	
 	Transformation(const Transformation &other)
 	{
 	}
 	
     public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+	~Transformation();
+
         /** Updates the data contained in the provided status structure with the
          * transformation's internal information
          */
@@ -92,20 +329,58 @@ class Transformation
 	    return targetFrameMapped;
 	}	
 
+	/**
+	 * returns the id of the (mapped) source frame in the TransformationTree
+	 * */
+	FrameId getSourceFrameId() const
+	{
+	    return sourceFrameId;
+	}
+
+	/**
+	 * returns the id of the (mapped) target frame in the TransformationTree
+	 * */
+	FrameId getTargetFrameId() const
+	{
+	    return targetFrameId;
+	}
+
         /** Clears all stored information and marks the transformation as
          * invalid
          */
         void reset()
         {
             valid = false;
+            version++;
+            releaseSegments();
             transformationChain.clear();
             lastGeneratedValue = base::Time();
             generatedTransformations = 0;
+            extrapolatedTransformations = 0;
             failedNoChain = 0;
             failedNoSample = 0;
             failedInterpolationImpossible = 0;
         }
 
+	/**
+	 * Returns a counter that gets incremented every time the value of this
+	 * transformation may have changed, i.e. when one of the elements of
+	 * its chain changes or when the chain itself changes
+	 * */
+	unsigned getVersion() const
+	{
+	    return version;
+	}
+
+	/**
+	 * Returns true if the transformation may have changed since
+	 * getVersion returned the given version
+	 * */
+	bool hasChangedSince(unsigned version) const
+	{
+	    return this->version != version;
+	}
+
 	/**
 	 * Registeres a callback (only one) callback, that is called,
 	 * whenever this transformation changes.
@@ -121,9 +396,154 @@ class Transformation
 	bool get(const base::Time& atTime, transformer::TransformationType& result, bool interpolate = false) const;
 	bool getChain(const base::Time& atTime, std::vector<TransformationType>& result, bool interpolate = false) const;
 
+	/**
+	 * Computes the transformation as a T. Isometry3d and Affine3d results
+	 * are computed from the chain segments. Other types are composed with
+	 * CompositionTraits<T>, and need to be constructible from an
+	 * Isometry3d.
+	 * */
 	template <class T>
 	bool get(const base::Time& atTime, T& result, bool interpolate = false) const;
 	bool getChain(const base::Time& atTime, std::vector<Eigen::Affine3d>& result, bool interpolate = false) const;
+
+	/**
+	 * Computes the transformation at 'count' timestamps at once.
+	 *
+	 * The timestamps must be sorted in ascending order. Each element of
+	 * the chain is evaluated once for all the timestamps, and static parts
+	 * of the chain are only composed once.
+	 *
+	 * @param times the timestamps, of size count
+	 * @param results the transformations at these times, of size count
+	 * @param valid set to true for the timestamps at which the
+	 *   transformation could be computed, of size count
+	 * @return the number of timestamps at which the transformation could
+	 *   be computed
+	 * */
+	size_t get(const base::Time *times, size_t count, Eigen::Isometry3d *results, bool *valid, bool interpolate = false) const;
+
+	/**
+	 * If enabled, get() for TransformationType also fills cov_position
+	 * and cov_orientation with the covariance propagated along the chain
+	 * (see getWithCovariance). Otherwise, the covariances are left
+	 * unset. Disabled by default.
+	 * */
+	void setCovariancePropagation(bool enable)
+	{
+	    propagateCovariance = enable;
+	}
+
+	bool isCovariancePropagationEnabled() const
+	{
+	    return propagateCovariance;
+	}
+
+	/**
+	 * Computes the transformation and its covariance, propagating the
+	 * covariances of the elements along the chain to first order.
+	 *
+	 * Each element contributes its own covariance, mapped into the target
+	 * frame with the adjoint of the part of the chain in front of it.
+	 *
+	 * Returns false if a sample is missing
+	 * */
+	bool getWithCovariance(const base::Time& atTime, Eigen::Isometry3d& pose, PoseCovariance& covariance, bool interpolate = false) const;
+
+	/**
+	 * Batch version of getWithCovariance, with the same semantics as the
+	 * batch get. Each element of the chain is evaluated once for all the
+	 * timestamps.
+	 *
+	 * @return the number of timestamps at which the transformation could
+	 *   be computed
+	 * */
+	size_t getWithCovariance(const base::Time *times, size_t count, Eigen::Isometry3d *poses, PoseCovariance *covariances, bool *valid, bool interpolate = false) const;
+
+	/**
+	 * Sets how queries after the latest sample of a dynamic element of
+	 * the chain are answered.
+	 *
+	 * By default, such interpolated queries fail until the next sample
+	 * arrives. With extrapolation enabled, the elements lacking a sample
+	 * are extrapolated at constant velocity instead, up to the horizon of
+	 * the policy. Only queries that would fail otherwise are
+	 * extrapolated, and they are counted separately in the status.
+	 * getWithCovariance does not extrapolate.
+	 * */
+	void setExtrapolation(const ExtrapolationPolicy &policy)
+	{
+	    extrapolation = policy;
+	}
+
+	const ExtrapolationPolicy &getExtrapolation() const
+	{
+	    return extrapolation;
+	}
+
+	/**
+	 * Gets the earliest time after the given one at which one of the
+	 * elements of the chain has a sample. Returns false if there is none.
+	 *
+	 * See TransformationSampleIterator to iterate over these times.
+	 * */
+	bool getSampleTimeAfter(const base::Time &time, base::Time &sampleTime) const;
+};
+
+/**
+ * Iterates over the values of a Transformation at the times of the samples
+ * of its elements in a time window, e.g. to integrate odometry or to export
+ * a trajectory:
+ *
+ *   TransformationSampleIterator it(transformation, start, end);
+ *   while(it.next())
+ *       process(it.getTime(), it.getPose());
+ *
+ * The sample times of all elements of the chain are merged, a time shared by
+ * several elements is visited once. Each value is computed by next() when it
+ * gets there, with Transformation::get, and times at which it cannot be
+ * computed are skipped. The iterator does not store the samples, so long
+ * windows are processed in constant memory.
+ *
+ * Only the samples still in the history of the elements are visited, not the
+ * decimated ones of their archive. The transformation must not be modified
+ * while iterating.
+ * */
+class TransformationSampleIterator
+{
+    public:
+	/**
+	 * @param start,end the time window, both included
+	 * @param interpolate passed to Transformation::get. It is set by
+	 *   default, so that the other elements of the chain are interpolated
+	 *   at the sample times of one element.
+	 * */
+	TransformationSampleIterator(const Transformation &transformation, const base::Time &start, const base::Time &end, bool interpolate = true);
+
+	/**
+	 * Moves to the next sample time of the window at which the
+	 * transformation could be computed. Returns false at the end of the
+	 * window.
+	 * */
+	bool next();
+
+	const base::Time &getTime() const
+	{
+	    return time;
+	}
+
+	const Eigen::Isometry3d &getPose() const
+	{
+	    return pose;
+	}
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    private:
+	const Transformation &transformation;
+	base::Time end;
+	bool interpolate;
+	///the current sample time, or the time before the window
+	base::Time time;
+	Eigen::Isometry3d pose;
 };
 
 /**
@@ -131,7 +551,7 @@ class Transformation
  * */
 class TransformationElement {
     public:
-	TransformationElement(const std::string &sourceFrame, const std::string &targetFrame): sourceFrame(sourceFrame), targetFrame(targetFrame) {};
+	TransformationElement(const std::string &sourceFrame, const std::string &targetFrame): version(0), sourceFrame(sourceFrame), targetFrame(targetFrame) {};
 	virtual ~TransformationElement() {};
 	
 	/**
@@ -143,23 +563,116 @@ class TransformationElement {
 	 * */
 	virtual bool getTransformation(const base::Time &atTime, bool doInterpolation, TransformationType &tr) = 0;
 
+	/**
+	 * Same as getTransformation, but only returns the rigid body
+	 * transformation, i.e. neither frame names, covariances nor
+	 * velocities. This is the method used to evaluate transformation
+	 * chains.
+	 *
+	 * The default implementation goes through getTransformation.
+	 * Subclasses should override it with a version that does not fill a
+	 * complete TransformationType.
+	 * */
+	virtual bool getPose(const base::Time &atTime, bool doInterpolation, Eigen::Isometry3d &pose);
+
+	/**
+	 * Batch version of getPose for 'count' timestamps sorted in ascending
+	 * order.
+	 *
+	 * Timestamps for which valid is already false are skipped. valid is
+	 * set to false for the timestamps at which no pose is available.
+	 *
+	 * The default implementation calls getPose for each timestamp.
+	 * */
+	virtual void getPoses(const base::Time *times, size_t count, bool doInterpolation, Eigen::Isometry3d *poses, bool *valid);
+
+	/**
+	 * Same as getPose, but also returns the covariance of the pose, see
+	 * PoseCovariance.
+	 *
+	 * The default implementation goes through getTransformation and
+	 * builds the covariance from cov_position and cov_orientation.
+	 * */
+	virtual bool getPoseWithCovariance(const base::Time &atTime, bool doInterpolation, Eigen::Isometry3d &pose, PoseCovariance &covariance);
+
+	/**
+	 * Batch version of getPoseWithCovariance, with the same semantics as
+	 * getPoses.
+	 *
+	 * The default implementation calls getPoseWithCovariance for each
+	 * timestamp.
+	 * */
+	virtual void getPosesWithCovariance(const base::Time *times, size_t count, bool doInterpolation, Eigen::Isometry3d *poses, PoseCovariance *covariances, bool *valid);
+
+	/**
+	 * Gets the time of the first sample of this element after the given
+	 * time. Returns false if there is none, or if the element has no
+	 * samples, which is the default.
+	 * */
+	virtual bool getSampleTimeAfter(const base::Time &time, base::Time &sampleTime) const
+	{
+	    return false;
+	}
+
+	/**
+	 * Same as getPose, but extrapolates according to the given policy
+	 * if there is no sample for the query. extrapolated is set if it
+	 * did.
+	 *
+	 * The default implementation does not extrapolate.
+	 * */
+	virtual bool getExtrapolatedPose(const base::Time &atTime, bool doInterpolation, const ExtrapolationPolicy &policy, Eigen::Isometry3d &pose, bool &extrapolated);
+
 	/**
 	 * This function registers a callback, that should be called every
 	 * time the TransformationElement changes its value. 
+	 *
+	 * @param owner an optional tag that allows to remove the callback
+	 *   later on with removeTransformationChangedCallbacks
 	 * */
-        virtual void addTransformationChangedCallback(boost::function<void (const base::Time &ts)> callback)
+        virtual void addTransformationChangedCallback(boost::function<void (const base::Time &ts)> callback, const void *owner = NULL)
         {
             elementChangedCallbacks.push_back(callback);
+            elementChangedCallbackOwners.push_back(owner);
         };
         
+        /**
+         * Removes all callbacks that were registered with the given owner
+         * */
+        virtual void removeTransformationChangedCallbacks(const void *owner);
+
+	/**
+	 * Returns the cost of using this element in a transformation chain,
+	 * in seconds. It is used to choose between several possible chains
+	 * when the cost based chain selection is enabled.
+	 *
+	 * The default is zero, i.e. the element never delays a transformation
+	 * */
+	virtual double getCost() const
+	{
+	    return 0;
+	}
+
         /**
          * Removes all registered callbacks
          * */
         virtual void clearTransformationChangedCallbacks()
         {
             elementChangedCallbacks.clear();
+            elementChangedCallbackOwners.clear();
         }
         
+	/**
+	 * Returns a counter that gets incremented every time the value of
+	 * this element changes, e.g. when a new sample arrives. It can be
+	 * used to find out whether values computed from this element are
+	 * still up to date.
+	 * */
+	virtual unsigned getVersion() const
+	{
+	    return version;
+	}
+
 	/**
 	 * returns the name of the source frame
 	 * */
@@ -177,7 +690,16 @@ class TransformationElement {
 	}
 
     protected:
+        /**
+         * Calls all registered callbacks
+         * */
+        void notifyTransformationChanged(const base::Time &ts);
+
         std::vector<boost::function<void (const base::Time &ts)> > elementChangedCallbacks;
+        ///owner tags of elementChangedCallbacks, in the same order
+        std::vector<const void *> elementChangedCallbackOwners;
+        ///see getVersion
+        unsigned version;
     private:
 	std::string sourceFrame;
 	std::string targetFrame;
@@ -188,7 +710,11 @@ class TransformationElement {
  * */
 class StaticTransformationElement : public TransformationElement {
     public:
-	StaticTransformationElement(const std::string &sourceFrame, const std::string &targetFrame, const TransformationType &transform) : TransformationElement(sourceFrame, targetFrame), staticTransform(transform) {};
+	StaticTransformationElement(const std::string &sourceFrame, const std::string &targetFrame, const TransformationType &transform) : TransformationElement(sourceFrame, targetFrame), staticTransform(transform)
+	{
+	    toPose(staticTransform, staticPose);
+	    toPoseCovariance(staticTransform, staticCovariance);
+	};
 	
 	virtual bool getTransformation(const base::Time& atTime, bool doInterpolation, TransformationType& tr)
 	{
@@ -196,36 +722,211 @@ class StaticTransformationElement : public TransformationElement {
             tr.time = atTime;
 	    return true;
 	};
+
+	virtual bool getPose(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose)
+	{
+	    pose = staticPose;
+	    return true;
+	};
+
+	virtual bool getPoseWithCovariance(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose, PoseCovariance& covariance)
+	{
+	    pose = staticPose;
+	    covariance = staticCovariance;
+	    return true;
+	};
+
+	/**
+	 * Replaces the stored transformation and calls the registered
+	 * callbacks
+	 * */
+	void setTransformation(const TransformationType &transform)
+	{
+	    staticTransform = transform;
+	    toPose(staticTransform, staticPose);
+	    toPoseCovariance(staticTransform, staticCovariance);
+	    notifyTransformationChanged(transform.time);
+	}
+
+	const TransformationType &getStaticTransformation() const
+	{
+	    return staticTransform;
+	}
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     private:
 	TransformationType staticTransform;
+	Eigen::Isometry3d staticPose;
+	PoseCovariance staticCovariance;
 };
 
-/**
- * This class represents a dynamic transformation
- * 
- * 
- * */
-class DynamicTransformationElement : public TransformationElement {
-    public:
-	DynamicTransformationElement(const std::string& sourceFrame, const std::string& targetFrame, aggregator::StreamAligner& aggregator, int priority = -10);
-	virtual ~DynamicTransformationElement();
-	
-	virtual bool getTransformation(const base::Time& atTime, bool doInterpolation, TransformationType& result);
-        
-	int getStreamIdx() const
+/**
+ * This class represents a dynamic transformation
+ * 
+ * The samples processed by the aggregator are kept in a bounded history, so
+ * that the transformation can be computed at any time inside of it.
+ * Queries after the latest sample are interpolated with the next sample
+ * queued in the aggregator.
+ * */
+class DynamicTransformationElement : public TransformationElement {
+    public:
+	DynamicTransformationElement(const std::string& sourceFrame, const std::string& targetFrame, aggregator::StreamAligner& aggregator, int priority = -10, size_t historySize = 100);
+	virtual ~DynamicTransformationElement();
+	
+	virtual bool getTransformation(const base::Time& atTime, bool doInterpolation, TransformationType& result);
+
+	virtual bool getPose(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose);
+
+	/**
+	 * Walks the history along the sorted timestamps and, when
+	 * interpolating past the latest sample, looks up the next queued
+	 * sample once for all timestamps.
+	 * */
+	virtual void getPoses(const base::Time *times, size_t count, bool doInterpolation, Eigen::Isometry3d *poses, bool *valid);
+
+	/**
+	 * Interpolates the covariances the same way getTransformation does,
+	 * without copying complete samples
+	 * */
+	virtual bool getPoseWithCovariance(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose, PoseCovariance& covariance);
+
+	virtual void getPosesWithCovariance(const base::Time *times, size_t count, bool doInterpolation, Eigen::Isometry3d *poses, PoseCovariance *covariances, bool *valid);
+
+	/**
+	 * Returns the times of the samples of the history
+	 * */
+	virtual bool getSampleTimeAfter(const base::Time &time, base::Time &sampleTime) const
+	{
+	    return history.getTimeAfter(time, sampleTime);
+	}
+
+	/**
+	 * Extrapolates the latest sample of the history, see extrapolatePose
+	 * */
+	virtual bool getExtrapolatedPose(const base::Time &atTime, bool doInterpolation, const ExtrapolationPolicy &policy, Eigen::Isometry3d &pose, bool &extrapolated);
+
+	/**
+	 * Returns the history of the samples
+	 * */
+	const PoseHistory &getHistory() const
+	{
+	    return history;
+	}
+
+	/**
+	 * Sets the number of samples kept in the history
+	 * */
+	void setHistorySize(size_t size)
+	{
+	    history.setCapacity(size);
+	}
+
+	/**
+	 * Configures the archive of the history, see PoseArchive::configure
+	 * */
+	void configureArchive(const base::Time &duration, double positionTolerance, double orientationTolerance)
+	{
+	    history.getArchive().configure(duration, positionTolerance, orientationTolerance);
+	}
+        
+	int getStreamIdx() const
+	{
+	    return streamIdx;
+	}
+
+	/**
+	 * Updates the period and latency estimates of this element with a newly
+	 * pushed sample.
+	 *
+	 * @param ts the timestamp of the sample
+	 * @param latestTime the latest timestamp of all samples pushed to the
+	 *   transformer so far. The latency is the time this sample is
+	 *   lagging behind it.
+	 * */
+	void updateStatistics(const base::Time &ts, const base::Time &latestTime);
+
+	/**
+	 * Returns the estimated period of the samples, in seconds
+	 * */
+	double getPeriod() const
+	{
+	    return period;
+	}
+
+	/**
+	 * Returns the estimated latency of the samples, in seconds
+	 * */
+	double getLatency() const
+	{
+	    return latency;
+	}
+
+	/**
+	 * Returns the timestamp of the last sample pushed for this element
+	 * */
+	const base::Time &getLastPushedTime() const
+	{
+	    return lastPushedTime;
+	}
+
+	/**
+	 * The cost of a dynamic element is the time a transformation may
+	 * have to wait for its next sample, i.e. its period plus its latency
+	 * */
+	virtual double getCost() const
 	{
-	    return streamIdx;
+	    return period + latency;
 	}
 	
     private:
 	
 	void aggregatorCallback(const base::Time &ts, const TransformationType &value); 
 
+	/**
+	 * Looks up the samples for the given query.
+	 *
+	 * On success, index is the sample of the history at or before atTime.
+	 * If interpolated is set, the value is the interpolation between this
+	 * sample and the one after it with the given factor. The sample after
+	 * the latest one of the history is the next sample queued in the
+	 * aggregator, which gets stored in nextSample. If reuseNextSample is
+	 * set, the one fetched by the previous lookup is used.
+	 * */
+	bool lookup(const base::Time &atTime, bool doInterpolation, bool reuseNextSample, size_t &index, bool &interpolated, double &factor);
+
+	/**
+	 * Computes the pose for the result of lookup
+	 * */
+	void evaluatePose(size_t index, bool interpolated, double factor, Eigen::Isometry3d &pose) const;
+
+	/**
+	 * Computes the covariance for the result of lookup
+	 * */
+	void evaluateCovariance(size_t index, bool interpolated, double factor, PoseCovariance &covariance) const;
+
+	/**
+	 * Implementation of getPoses and getPosesWithCovariance. covariances
+	 * may be NULL.
+	 * */
+	void evaluatePoses(const base::Time *times, size_t count, bool doInterpolation, Eigen::Isometry3d *poses, PoseCovariance *covariances, bool *valid);
+
 	aggregator::StreamAligner &aggregator;
-	base::Time lastTransformTime;
+	///the latest sample, as given by the aggregator
 	TransformationType lastTransform;
-	bool gotTransform;
+	PoseHistory history;
 	int streamIdx;
+
+	///see lookup
+	std::pair<base::Time, TransformationType> nextSample;
+	bool gotNextSample;
+
+	///timestamp of the last pushed sample, used for the period estimate
+	base::Time lastPushedTime;
+	///moving averages of the sample period and latency, in seconds
+	double period;
+	double latency;
+
+    public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
 /**
@@ -233,56 +934,183 @@ class DynamicTransformationElement : public TransformationElement {
  * */
 class InverseTransformationElement : public TransformationElement {
     public:
-	InverseTransformationElement(TransformationElement *source): TransformationElement(source->getTargetFrame(), source->getSourceFrame()), nonInverseElement(source) {};
+	InverseTransformationElement(TransformationElement *source): TransformationElement(source->getTargetFrame(), source->getSourceFrame()), nonInverseElement(source), cacheValid(false) {};
 	virtual bool getTransformation(const base::Time& atTime, bool doInterpolation, TransformationType& tr);
 
-	virtual void addTransformationChangedCallback(boost::function<void (const base::Time &ts)> callback) 
+	/**
+	 * Returns the inverse of the pose of the wrapped element. The result
+	 * is cached until the wrapped element changes or another time is
+	 * requested.
+	 * */
+	virtual bool getPose(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose);
+
+	virtual bool getPoseWithCovariance(const base::Time& atTime, bool doInterpolation, Eigen::Isometry3d& pose, PoseCovariance& covariance);
+
+	virtual bool getExtrapolatedPose(const base::Time &atTime, bool doInterpolation, const ExtrapolationPolicy &policy, Eigen::Isometry3d &pose, bool &extrapolated);
+
+	virtual bool getSampleTimeAfter(const base::Time &time, base::Time &sampleTime) const
+	{
+	    return nonInverseElement->getSampleTimeAfter(time, sampleTime);
+	}
+
+	virtual unsigned getVersion() const
+	{
+	    return nonInverseElement->getVersion();
+	}
+
+	virtual void addTransformationChangedCallback(boost::function<void (const base::Time &ts)> callback, const void *owner = NULL) 
+	{
+	    nonInverseElement->addTransformationChangedCallback(callback, owner);
+	};
+
+	virtual void removeTransformationChangedCallbacks(const void *owner)
 	{
-	    nonInverseElement->addTransformationChangedCallback(callback);
+	    nonInverseElement->removeTransformationChangedCallbacks(owner);
 	};
 	
         TransformationElement* getElement();
         TransformationElement const* getElement() const;
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     private:
 	TransformationElement *nonInverseElement;
-};
 
+	///the last value returned by getPose, and the query it belongs to
+	bool cacheValid;
+	unsigned cachedVersion;
+	base::Time cachedTime;
+	bool cachedInterpolation;
+	Eigen::Isometry3d cachedPose;
+};
 
-class  TransformationNode;
 
 /**
  * A class that can be used to get a transformation chain from a set of TransformationElements
+ *
+ * The tree interns every frame name it sees into a FrameId and keeps, for
+ * each frame, the list of edges leaving it. Every added element is reachable
+ * in both directions, the reverse direction being represented by an edge with
+ * the inverse flag set.
  * */
 class TransformationTree
 {
     public:
 	///default constructor
-	TransformationTree() : maxSeekDepth(20) {};
+	TransformationTree() : maxSeekDepth(20), costBasedSelection(false), searchId(0) {};
+
+	/**
+	 * Enables or disables the cost based chain selection.
+	 *
+	 * By default, getTransformationChain returns the chain with the
+	 * smallest number of elements. With cost based selection, it returns
+	 * the one with the smallest sum of TransformationElement::getCost(),
+	 * using the number of elements to choose between chains of equal
+	 * cost.
+	 * */
+	void setCostBasedSelection(bool enable)
+	{
+	    costBasedSelection = enable;
+	}
+
+	bool isCostBasedSelection() const
+	{
+	    return costBasedSelection;
+	}
 
         /** Returns the number of registered elements in the tree, as a (static
          * elements, dynamic elements) pair
          */
         std::pair<int, int> getElementsCount() const;
 	
+	/**
+	 * Returns the id of the given frame, registering the frame if it is
+	 * not known yet.
+	 *
+	 * Frame ids stay valid for the lifetime of the tree, they are not
+	 * affected by clear()
+	 * */
+	FrameId getFrameId(const std::string &frameName);
+
+	/**
+	 * Looks up the id of the given frame without registering it.
+	 *
+	 * Returns false if the frame is not known to the tree
+	 * */
+	bool findFrameId(const std::string &frameName, FrameId &id) const;
+
+	/**
+	 * Returns the name of the frame with the given id
+	 * */
+	const std::string &getFrameName(FrameId frame) const
+	{
+	    return frameNames[frame];
+	}
+
+	/**
+	 * Returns the number of frames known to the tree
+	 * */
+	size_t getFrameCount() const
+	{
+	    return frameNames.size();
+	}
+
+	/**
+	 * Returns the connected component the given frame belongs to.
+	 *
+	 * Two frames are in the same component if and only if a
+	 * transformation chain exists between them. The returned value is a
+	 * representative frame of the component, it is only meaningful until the
+	 * next change of the tree.
+	 * */
+	FrameId getComponent(FrameId frame) const;
+
+	/**
+	 * Returns the edges leaving the given frame
+	 * */
+	const std::vector<TransformationEdge> &getEdges(FrameId frame) const
+	{
+	    return adjacency[frame];
+	}
+
 	/**
 	 * Adds a TransformationElement to the set of available elements.
 	 * 
 	 * Note, internal the TransformationTree will also add an inverse
-	 * transformation.
+	 * edge from the target to the source frame of the element.
 	 * */
 	void addTransformation(TransformationElement *element);
+
+	/**
+	 * Removes the element and its inverse edge from the tree, and deletes
+	 * it.
+	 *
+	 * The connected components are recomputed, as the removal might split
+	 * one. Chains that contain the element become invalid, it is the
+	 * caller's responsibility to not use them anymore.
+	 * */
+	void removeTransformation(TransformationElement *element);
 	
 	/**
 	 * This function tries to generate a transformationChain from 'from' to 'to'.
 	 * 
-	 * To generate the transformationChain this function will spann a tree of
-	 * transformations originating from 'from'. The function will then perform a
-	 * breadth-first search until it either finds a chain, the tree can't be expanded
-	 * further, or the search depth is deeper than maxSeekDepth.
+	 * The function performs a bidirectional breadth-first search, growing
+	 * one frontier from 'from' and one from 'to', until the two meet, one of
+	 * them can't be expanded further, or the chain would get longer than
+	 * maxSeekDepth. Every frame is visited at most once per direction, so
+	 * the search is linear in the size of the graph even if it contains
+	 * loops. The search state lives in a workspace owned by the tree, which
+	 * only grows when new frames get registered.
+	 * 
+	 * If the cost based selection is enabled, a Dijkstra search on the
+	 * element costs is performed instead, using the same workspace.
 	 * 
 	 * In case a chain was found the function returns true and the chain is stored in result.
 	 * */
-	bool getTransformationChain(std::string from, std::string to, std::vector<TransformationElement *> &result);
+	bool getTransformationChain(FrameId from, FrameId to, std::vector<TransformationEdge> &result);
+
+	/**
+	 * Convenience version of getTransformationChain that takes frame names
+	 * */
+	bool getTransformationChain(const std::string &from, const std::string &to, std::vector<TransformationEdge> &result);
 	
         /**
          * Returns a vector of all currently registered transformation elements.
@@ -311,23 +1139,56 @@ class TransformationTree
 	const int maxSeekDepth;
 
 	/**
-	 * This function will expand the given node.
-	 * 
-	 * To expand the node, the function will look up all available TransformationElements
-	 * add new node for those, where the sourceFrame matches from
+	 * Starts a new search, making sure the workspace can hold all frames
 	 * */
-	void addMatchingTransforms(std::string from, transformer::TransformationNode* node);
-	
+	void prepareSearch();
+
 	/**
-	 * Seeks through childs of the node and looks for a node that has frame 'to'
-	 * 
-	 * If found the function returns an iterator the the child.
-	 * If not returns an iterator pointing to node.childs.end()
+	 * Expands the current level of the given search direction (0 is
+	 * forward from the source frame, 1 is backward from the target frame).
+	 *
+	 * Returns the frame where the two directions met with the shortest
+	 * total chain, or -1 if they did not meet
 	 * */
-	std::vector< TransformationNode* >::const_iterator checkForMatchingChildFrame(const std::string &to, const TransformationNode &node);
+	FrameId expandSearchLevel(int direction, size_t &head);
+
+	/**
+	 * Cost based version of getTransformationChain
+	 * */
+	bool getCheapestTransformationChain(FrameId from, FrameId to, std::vector<TransformationEdge> &result);
+
+	bool costBasedSelection;
 	
 	/// List of available transformation elements
 	std::vector<TransformationElement *> availableElements;
+
+	/// Mapping from frame names to frame ids
+	std::map<std::string, FrameId> frameIds;
+	/// Frame names, indexed by frame id
+	std::vector<std::string> frameNames;
+	/// Edges leaving each frame, indexed by frame id
+	std::vector< std::vector<TransformationEdge> > adjacency;
+	/// Union-find forest of the connected components, indexed by frame id
+	mutable std::vector<FrameId> componentParents;
+
+	/// Id of the current search, used to mark visited frames
+	unsigned searchId;
+	/// Search workspace, for the forward [0] and backward [1] direction
+	/// Frames visited during the current search are marked with searchId
+	std::vector<unsigned> searchMarks[2];
+	/// Distance of the visited frames to the start of the direction
+	std::vector<int> searchDepths[2];
+	/// Frame from which each frame has been reached
+	std::vector<FrameId> searchParents[2];
+	/// Edge through which each frame has been reached, oriented from the
+	/// source to the target frame of the searched chain
+	std::vector<TransformationEdge> searchEdges[2];
+	/// Frames in the order in which they got visited
+	std::vector<FrameId> searchQueues[2];
+	/// Cost of the visited frames in the cost based search
+	std::vector<double> searchCosts;
+	/// Priority queue of the cost based search, as a (cost, chain length) and frame pair
+	std::vector< std::pair< std::pair<double, int>, FrameId > > searchHeap;
 };
 
 /**
@@ -337,13 +1198,117 @@ class Transformer
 {
     protected:
 	aggregator::StreamAligner aggregator;
-	std::map<std::pair<std::string, std::string>, int> transformToStreamIndex;
+	std::map<std::pair<FrameId, FrameId>, DynamicTransformationElement *> dynamicTransformations;
+	std::map<std::pair<FrameId, FrameId>, StaticTransformationElement *> staticTransformations;
 	std::vector<Transformation *> transformations;
 	TransformationTree transformationTree;
+	///cache used to compute transformations in tree mode, NULL otherwise
+	SpanningTreeCache *treeCache;
+	///segments shared between the chains of the transformations
+	ChainSegmentCache *segmentCache;
 	int priority;
         TransformerStatus transformerStatus;
+	///element costs at the time the chains have last been planned with them
+	std::map<TransformationElement *, double> plannedCosts;
+	///latest timestamp of the dynamic samples pushed so far
+	base::Time latestDynamicTime;
+	///nesting depth of beginTopologyUpdate calls
+	int topologyUpdateDepth;
+	///frames whose whole component needs new chains
+	std::vector<FrameId> pendingComponents;
+	///transformations that need a new chain
+	std::vector<Transformation *> pendingTransformations;
+	///global frame each local frame is mapped to, indexed by the local
+	///frame id. -1 (or an index past the end) means not mapped
+	std::vector<FrameId> frameMappings;
+	///time without samples after which dynamic transformations are evicted
+	base::Time idleTimeout;
+	///value of latestDynamicTime at the last idle check
+	base::Time lastIdleCheck;
+	///see setHistorySize
+	size_t historySize;
+	///see setHistoryArchive
+	base::Time archiveDuration;
+	double archivePositionTolerance;
+	double archiveOrientationTolerance;
+	///streams registered with registerJointStream, indexed by their id
+	std::vector<JointStateStream *> jointStreams;
+
+	/**
+	 * Deletes the joint state streams. Their elements must have been
+	 * deleted before.
+	 * */
+	void clearJointStreams();
 
+	/**
+	 * Searches new transformation chains for all registered transformations
+	 * */
 	void recomputeAvailableTransformations();
+
+	/**
+	 * Looks up the ids of the (mapped) frames of the given transformation
+	 * in the frame mapping table.
+	 *
+	 * Returns true if they changed
+	 * */
+	bool updateFrameIds(Transformation &transformation);
+
+	/**
+	 * Returns the global frame the given local frame is mapped to, or the
+	 * frame itself if it is not mapped
+	 * */
+	FrameId getMappedFrameId(FrameId frame) const
+	{
+	    if(frame < (FrameId)frameMappings.size() && frameMappings[frame] != -1)
+		return frameMappings[frame];
+	    return frame;
+	}
+
+	/**
+	 * Searches a transformation chain for the given transformation and
+	 * replaces the callback registrations of its previous chain.
+	 *
+	 * If no chain can be found, the transformation is marked as invalid.
+	 * */
+	void resolveTransformation(Transformation &transformation);
+
+	/**
+	 * Adds the element to the transformation tree and re-solves the
+	 * transformations that this new element can change, i.e. the
+	 * unresolved ones whose frames just got connected, and the resolved
+	 * ones in the element's component if the element closes a loop (and
+	 * therefore might offer a shorter chain).
+	 * */
+	void addTransformationElement(TransformationElement *element);
+
+	/**
+	 * Removes the element from the transformation tree and deletes it.
+	 *
+	 * The transformations that use the element are invalidated and
+	 * re-solved, the other ones are left untouched.
+	 * */
+	void removeTransformationElement(TransformationElement *element);
+
+	/**
+	 * Evicts the idle dynamic transformations if the idle timeout is set
+	 * and the last check is older than half of the timeout
+	 * */
+	void checkIdleTransformations();
+
+	/**
+	 * Re-solves the pending transformations, the ones in the pending
+	 * components, and the unresolved ones whose frames are connected.
+	 *
+	 * Does nothing while a topology update is in progress
+	 * */
+	void applyTopologyChanges();
+
+	/**
+	 * If the cost based chain selection is enabled, re-plans the chains
+	 * of the element's component when the element's cost drifted too far
+	 * from the one used when planning them.
+	 * */
+	void checkCostDrift(TransformationElement *element);
 	
     public:
 	
@@ -352,8 +1317,7 @@ class Transformer
 	 *
 	 * @param priority - stream priority which is given to dynamic transform streams.
 	 */
-	Transformer( int priority = -10 ) 
-	    : priority( priority ) {};
+	Transformer( int priority = -10 );
 	
 	/**
 	 * Deletes all dynamic and static transformations
@@ -476,8 +1440,12 @@ class Transformer
 	
 	/**
 	 * Process data streams, this basically calls StreamAligner::step().
+	 *
+	 * Idle dynamic transformations are evicted beforehand, see
+	 * setIdleTimeout.
 	 * */
 	int step() {
+	    checkIdleTransformations();
 	    return aggregator.step();
 	}
 	
@@ -503,14 +1471,221 @@ class Transformer
 	 * */
 	virtual void pushDynamicTransformation(const TransformationType &tr);
 	
+	/**
+	 * Removes a dynamic transformation that has been created by
+	 * pushDynamicTransformation.
+	 *
+	 * The corresponding aggregator stream is unregistered, including its
+	 * pending samples, and only the transformations whose chain used it
+	 * are re-solved. This must not be called from within a callback of
+	 * the transformer.
+	 *
+	 * Returns false if no dynamic transformation is known for this pair
+	 * of frames. Unknown frame names are not registered by the lookup.
+	 *
+	 * The frames themselves stay known to the transformation tree, as
+	 * registered transformations and caches refer to them by id: each
+	 * frame ever seen keeps its name, an empty edge list, a union-find
+	 * entry and a slot in the search workspace.
+	 * */
+	virtual bool removeDynamicTransformation(const std::string &sourceFrame, const std::string &targetFrame);
+
+	/**
+	 * Sets the number of samples each dynamic transformation and joint
+	 * stream keeps in its history, i.e. how far in the past it can be
+	 * queried. Applies to the existing and the new ones. Defaults to 100.
+	 * */
+	virtual void setHistorySize(size_t size);
+
+	size_t getHistorySize() const
+	{
+	    return historySize;
+	}
+
+	/**
+	 * Keeps the samples that leave the history of the dynamic
+	 * transformations in a compressed archive for the given duration, so
+	 * that transformations can be queried that far in the past.
+	 *
+	 * The archive decimates the samples: queries in its span are
+	 * answered from the trajectory interpolated between the kept samples,
+	 * which is within the given tolerances of the original samples. It
+	 * keeps neither covariances nor velocities: in its span,
+	 * getWithCovariance and queries with covariance propagation enabled
+	 * fail, and the elements return NaN covariances from
+	 * getTransformation, e.g. through Transformation::getChain.
+	 *
+	 * Applies to the existing and the new dynamic transformations, and
+	 * clears their archives. A zero duration disables the archive, which
+	 * is the default.
+	 *
+	 * @param positionTolerance in meters
+	 * @param orientationTolerance in radians
+	 * */
+	virtual void setHistoryArchive(const base::Time &duration, double positionTolerance, double orientationTolerance);
+
+	/**
+	 * Sets the time after which dynamic transformations that did not get
+	 * any new sample are removed. A null time (the default) disables the
+	 * eviction.
+	 *
+	 * The time is measured on the sample timestamps, relative to the
+	 * newest dynamic sample pushed to the transformer. The check is done
+	 * at most twice per timeout period, by step(), before any callback
+	 * gets called: removing a transformation unregisters its stream, which
+	 * the aggregator does not allow from within a callback. The
+	 * NonAligningTransformer, whose transformations have no stream,
+	 * checks in pushDynamicTransformation.
+	 * */
+	void setIdleTimeout(const base::Time &timeout)
+	{
+	    idleTimeout = timeout;
+	}
+
+	const base::Time &getIdleTimeout() const
+	{
+	    return idleTimeout;
+	}
+
+	/**
+	 * Removes all dynamic transformations whose last sample is older than
+	 * now - getIdleTimeout()
+	 *
+	 * As for removeDynamicTransformation, the frames of the evicted
+	 * transformations stay registered in the tree, so a transformer that
+	 * keeps seeing new frame names grows by a few words per name.
+	 * */
+	virtual void evictIdleTransformations(const base::Time &now);
+
 	/**
 	 * Function for adding static Transformations.
+	 *
+	 * If a static transformation between the same two frames (in either
+	 * direction) is already known, its value is replaced in place: the
+	 * transformation tree and the chains are left untouched, and only the
+	 * transformations using it get their change callback called.
 	 * */
 	void pushStaticTransformation(const TransformationType &tr);
 
+	/**
+	 * Adds a set of static transformations, resolving the transformation
+	 * chains only once all of them have been added
+	 * */
+	void pushStaticTransformations(const std::vector<TransformationType> &transforms);
+
+	/**
+	 * Adds a user provided element to the transformation tree, e.g. a
+	 * FrameGraphElement.
+	 *
+	 * The transformer takes ownership of the element, which gets deleted
+	 * by clear(). The element has to call its change callbacks whenever
+	 * its value changes.
+	 * */
+	void pushTransformationElement(TransformationElement *element);
+
+	/**
+	 * Registers a set of joints whose positions are given by a single
+	 * stream of joint state samples, see JointStateStream. Each joint
+	 * becomes a transformation from its child to its parent link.
+	 *
+	 * @return the id of the stream, to be given to pushJointState
+	 * */
+	int registerJointStream(const std::vector<JointDescription> &joints, const std::string &name = std::string("joints"));
+
+	/**
+	 * Pushes a joint state sample to the stream with the given id
+	 * */
+	virtual void pushJointState(int idx, const base::samples::Joints &joints);
+
+	/**
+	 * Starts a batch of topology changes.
+	 *
+	 * Until the matching commitTopologyUpdate, new static and dynamic
+	 * transformations, frame mappings and registered transformations are
+	 * only recorded. The chains and callbacks of all affected
+	 * transformations are then updated in a single pass on commit.
+	 *
+	 * Calls can be nested, only the outermost commit updates the chains.
+	 * */
+	void beginTopologyUpdate();
+
+	/**
+	 * Ends a batch of topology changes started with beginTopologyUpdate
+	 * */
+	void commitTopologyUpdate();
+
 	
+	/**
+	 * Maps the local frame 'frameName' to the global frame 'newName'.
+	 *
+	 * Registered transformations refer to their frames by local name. The
+	 * transformer keeps a single mapping table that is consulted when
+	 * resolving the chains, so the mapping applies to the transformations
+	 * registered before and after this call. An empty newName removes the
+	 * mapping.
+	 *
+	 * Only the transformations that use the remapped frame get a new
+	 * chain.
+	 * */
 	void setFrameMapping(const std::string &frameName, const std::string &newName);
 
+	/**
+	 * Sets a set of frame mappings, as local name to global name, at once.
+	 *
+	 * The transformations using any of the remapped frames are re-solved
+	 * in a single pass, once the whole table has been updated.
+	 * */
+	void setFrameMappings(const std::map<std::string, std::string> &mappings);
+
+	/**
+	 * Enables or disables the cost based chain selection.
+	 *
+	 * When enabled, the transformer chooses the chain with the smallest
+	 * cost among all possible chains. Static transformations cost nothing,
+	 * dynamic ones cost their observed sample period and latency (see
+	 * DynamicTransformationElement::getCost). The chains get re-planned
+	 * whenever the cost of a dynamic transformation changes by more than
+	 * costDriftRatio.
+	 * */
+	void setCostBasedChainSelection(bool enable);
+
+	/**
+	 * Relative change of an element's cost above which the chains get
+	 * re-planned
+	 * */
+	static const double costDriftRatio;
+
+	/**
+	 * Absolute change of an element's cost, in seconds, below which the
+	 * chains are never re-planned
+	 * */
+	static const double minCostDrift;
+
+	/**
+	 * Enables or disables the tree mode.
+	 *
+	 * In tree mode, the transformer keeps a spanning tree of the known
+	 * transformations and caches, for the last requested time, the
+	 * transformation of every frame relative to the root of the tree.
+	 * Transformation::get is then served from this cache, so that its cost
+	 * does not depend on the chain length and the upper part of the tree
+	 * is only evaluated once for all transformations queried at the same
+	 * time.
+	 *
+	 * The transformation chains are the paths along the spanning tree. The
+	 * tree mode should therefore only be used on tree-shaped frame graphs,
+	 * in which there is only one chain between any two frames.
+	 * */
+	void setTreeMode(bool enable);
+
+	/**
+	 * Returns true if the tree mode is enabled
+	 * */
+	bool isTreeMode() const
+	{
+	    return treeCache != NULL;
+	}
+
 	/** 
 	 * @return the status of the StreamAligner, which contains current latency
 	 * and buffer fill sizes of the individual streams.
@@ -532,35 +1707,71 @@ class Transformer
 };
 
 template<class T>
-bool Transformation::get(const base::Time& atTime, T& result, bool interpolate) const
+bool Transformation::evaluate(const base::Time& atTime, bool interpolate, T& result) const
 {
-    result = T::Identity();
-    if (!valid)
+    Eigen::Isometry3d pose;
+    if (treeCache || staticChain)
     {
-        failedNoChain++;
-        return false;
+        //these are memoized as isometries
+        if(!evaluate(atTime, interpolate, pose))
+            return false;
+        result = T(pose);
+        return true;
     }
 
-    for(std::vector<TransformationElement *>::const_iterator it = transformationChain.begin(); it != transformationChain.end(); it++)
+    //the edges are gathered in blocks, each composed with composeChain
+    const size_t blockSize = 8;
+    T block[blockSize];
+    T blockResult;
+    T composed;
+    size_t count = 0;
+    for(std::vector<TransformationEdge>::const_iterator it = transformationChain.begin(); it != transformationChain.end(); it++)
     {
-	TransformationType tr;
-	if(!(*it)->getTransformation(atTime, interpolate, tr))
-	{
+        if(!it->element->getPose(atTime, interpolate, pose))
+        {
+            if(extrapolateChain(atTime, interpolate, pose))
+            {
+                result = T(pose);
+                return true;
+            }
+
             if (interpolate)
                 failedInterpolationImpossible++;
             else
                 failedNoSample++;
 
-	    //no sample available, return
-	    return false;
-	}
-	
-	//TODO, this might be a costly operation
-	T trans( tr );
-	
-	//apply transformation
-	result = result * trans;
+            //no sample available, return
+            return false;
+        }
+
+        if(it->inverse)
+            pose = pose.inverse(Eigen::Isometry);
+        block[count++] = T(pose);
+
+        if(count == blockSize || it + 1 == transformationChain.end())
+        {
+            CompositionTraits<T>::composeChain(block, count, blockResult);
+            CompositionTraits<T>::compose(result, blockResult, composed);
+            result = composed;
+            count = 0;
+        }
+    }
+    return true;
+}
+
+template<class T>
+bool Transformation::get(const base::Time& atTime, T& result, bool interpolate) const
+{
+    result = T::Identity();
+    if (!valid)
+    {
+        failedNoChain++;
+        return false;
     }
+
+    if(!evaluate(atTime, interpolate, result))
+        return false;
+
     lastGeneratedValue = atTime;
     generatedTransformations++;
     return true;
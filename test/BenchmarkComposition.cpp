@@ -0,0 +1,181 @@
+#include <transformer/NonAligningTransformer.hpp>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+
+using namespace transformer;
+
+/**
+ * Compares, for several chain lengths, the time Transformation::get needs
+ * for an interpolated query on a chain of dynamic transformations, per
+ * result type, with the generic path used by get before the composition
+ * traits: one TransformationType per edge, composed with Affine3d products
+ * and general inverses. Every other edge of the chains is inverted.
+ * */
+
+static const int repetitions = 20000;
+
+static double randomValue()
+{
+    return (double)rand() / RAND_MAX * 2.0 - 1.0;
+}
+
+static TransformationType randomTransformation(const std::string &source, const std::string &target, const base::Time &time)
+{
+    TransformationType tr;
+    tr.initSane();
+    tr.sourceFrame = source;
+    tr.targetFrame = target;
+    tr.time = time;
+    tr.orientation = Eigen::Quaterniond(randomValue(), randomValue(), randomValue(), randomValue());
+    tr.orientation.normalize();
+    tr.position = Eigen::Vector3d(randomValue(), randomValue(), randomValue());
+    return tr;
+}
+
+static std::string frameName(size_t index)
+{
+    std::ostringstream name;
+    name << "frame" << index;
+    return name.str();
+}
+
+static base::Time queryTime(int repetition)
+{
+    //a different time for every query, so that nothing is reused
+    return base::Time::fromMicroseconds(1000000 + repetition % 1000000);
+}
+
+/**
+ * An edge of the benchmarked chain, for the generic path
+ * */
+struct Edge
+{
+    TransformationElement *element;
+    bool inverse;
+};
+
+/**
+ * The generic path: result = result * Affine3d(getTransformation(...))
+ * */
+static bool composeGeneric(const std::vector<Edge> &chain, const base::Time &atTime, Eigen::Affine3d &result)
+{
+    result = Eigen::Affine3d::Identity();
+    TransformationType tr;
+    for(std::vector<Edge>::const_iterator it = chain.begin(); it != chain.end(); it++)
+    {
+        if(!it->element->getTransformation(atTime, true, tr))
+            return false;
+        if(it->inverse)
+            result = result * Eigen::Affine3d(tr).inverse();
+        else
+            result = result * Eigen::Affine3d(tr);
+    }
+    return true;
+}
+
+/**
+ * Returns the time per query of the generic path in nanoseconds
+ * */
+static double benchmarkGeneric(const std::vector<Edge> &chain, Eigen::Affine3d &result)
+{
+    base::Time start = base::Time::now();
+    for(int i = 0; i < repetitions; i++)
+    {
+        if(!composeGeneric(chain, queryTime(i), result))
+            return -1;
+        //keep the compiler from hoisting the query out of the loop
+        asm volatile("" : : "g"(&result) : "memory");
+    }
+    return (base::Time::now() - start).toSeconds() * 1e9 / repetitions;
+}
+
+/**
+ * Returns the time per query in nanoseconds
+ * */
+template<class T>
+static double benchmark(const Transformation &transformation, T &result)
+{
+    base::Time start = base::Time::now();
+    for(int i = 0; i < repetitions; i++)
+    {
+        if(!transformation.get(queryTime(i), result, true))
+            return -1;
+        asm volatile("" : : "g"(&result) : "memory");
+    }
+    return (base::Time::now() - start).toSeconds() * 1e9 / repetitions;
+}
+
+int main(int argc, char **argv)
+{
+    std::cout << std::setw(8) << "length"
+        << std::setw(12) << "generic"
+        << std::setw(12) << "Affine3d"
+        << std::setw(12) << "Isometry3d"
+        << std::setw(12) << "Quaternion"
+        << std::setw(12) << "DualQuat"
+        << "  [ns per query] (speedup against generic)" << std::endl;
+
+    //longer chains are not found by the transformation tree search
+    for(size_t length = 1; length <= 16; length *= 2)
+    {
+        NonAligningTransformer tf;
+        const Transformation &transformation = tf.registerTransformation(frameName(0), frameName(length));
+        std::vector<Edge> chain;
+        for(size_t i = 0; i < length; i++)
+        {
+            Edge edge;
+            edge.inverse = i % 2;
+            std::string source = frameName(edge.inverse ? i + 1 : i);
+            std::string target = frameName(edge.inverse ? i : i + 1);
+            NonAlignedDynamicTransformationElement *element = new NonAlignedDynamicTransformationElement(source, target);
+            element->setTransformation(base::Time::fromSeconds(1), randomTransformation(source, target, base::Time::fromSeconds(1)));
+            element->setTransformation(base::Time::fromSeconds(2), randomTransformation(source, target, base::Time::fromSeconds(2)));
+            tf.pushTransformationElement(element);
+            edge.element = element;
+            //chains start at the target frame
+            chain.insert(chain.begin(), edge);
+        }
+
+        Eigen::Affine3d generic;
+        Eigen::Affine3d affine;
+        Eigen::Isometry3d isometry;
+        QuaternionTransform quaternion;
+        DualQuaternion dualQuaternion;
+        double genericTime = benchmarkGeneric(chain, generic);
+        double affineTime = benchmark(transformation, affine);
+        double isometryTime = benchmark(transformation, isometry);
+        double quaternionTime = benchmark(transformation, quaternion);
+        double dualQuaternionTime = benchmark(transformation, dualQuaternion);
+
+        if(genericTime < 0 || affineTime < 0 || isometryTime < 0 || quaternionTime < 0 || dualQuaternionTime < 0)
+        {
+            std::cerr << "query failed for a chain of length " << length << std::endl;
+            return 1;
+        }
+
+        if(!affine.matrix().isApprox(generic.matrix()) ||
+            !isometry.matrix().isApprox(generic.matrix()) ||
+            !quaternion.toIsometry().matrix().isApprox(generic.matrix()) ||
+            !dualQuaternion.toIsometry().matrix().isApprox(generic.matrix()))
+        {
+            std::cerr << "results differ for a chain of length " << length << std::endl;
+            return 1;
+        }
+
+        std::cout << std::fixed << std::setprecision(1)
+            << std::setw(8) << length
+            << std::setw(12) << genericTime
+            << std::setw(12) << affineTime
+            << std::setw(12) << isometryTime
+            << std::setw(12) << quaternionTime
+            << std::setw(12) << dualQuaternionTime
+            << "  (" << std::setprecision(2)
+            << genericTime / affineTime << "x / "
+            << genericTime / isometryTime << "x / "
+            << genericTime / quaternionTime << "x / "
+            << genericTime / dualQuaternionTime << "x)" << std::endl;
+    }
+    return 0;
+}
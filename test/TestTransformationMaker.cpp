@@ -8,8 +8,15 @@
 
 #include <Eigen/Geometry>
 #include <transformer/Transformer.hpp>
+#include <transformer/NonAligningTransformer.hpp>
+#include <transformer/ChainSegmentCache.hpp>
+#include <transformer/PointTransform.hpp>
+#include <transformer/FrameGraph.hpp>
+#include <transformer/JointElements.hpp>
+#include <transformer/PoseHistory.hpp>
 #include <base/samples/laser_scan.h>
 #include <Eigen/SVD>
+#include <sstream>
 
 using namespace std;
 
@@ -414,3 +421,1354 @@ BOOST_AUTO_TEST_CASE( interpolate )
     BOOST_CHECK_EQUAL (translation.isApprox(Eigen::Vector3d(5,0,0)), true);    
 }
 
+
+BOOST_AUTO_TEST_CASE( tree_frame_ids_and_inverse_edges )
+{
+    transformer::TransformationTree tree;
+    
+    TransformationType body2Robot;
+    body2Robot.sourceFrame = "body";
+    body2Robot.targetFrame = "robot";
+    body2Robot.orientation = Eigen::Quaterniond::Identity();
+    body2Robot.position = Eigen::Vector3d(1,0,0);
+
+    TransformationType body2Laser;
+    body2Laser.sourceFrame = "body";
+    body2Laser.targetFrame = "laser";
+    body2Laser.orientation = Eigen::Quaterniond(Eigen::AngleAxisd(M_PI/2.0, Eigen::Vector3d::UnitZ()));
+    body2Laser.position = Eigen::Vector3d(0,2,0);
+
+    tree.addTransformation(new StaticTransformationElement("body", "robot", body2Robot));
+    tree.addTransformation(new StaticTransformationElement("body", "laser", body2Laser));
+
+    FrameId laser = tree.getFrameId("laser");
+    FrameId robot = tree.getFrameId("robot");
+    BOOST_CHECK_EQUAL( laser, tree.getFrameId("laser") );
+    BOOST_CHECK_EQUAL( std::string("robot"), tree.getFrameName(robot) );
+    BOOST_CHECK_EQUAL( 3, tree.getFrameCount() );
+
+    FrameId found;
+    BOOST_CHECK( tree.findFrameId("laser", found) );
+    BOOST_CHECK_EQUAL( laser, found );
+    BOOST_CHECK( !tree.findFrameId("camera", found) );
+    BOOST_CHECK_EQUAL( 3, tree.getFrameCount() );
+
+    std::vector<TransformationEdge> chain;
+    BOOST_REQUIRE( tree.getTransformationChain(laser, robot, chain) );
+    BOOST_REQUIRE_EQUAL( 2, chain.size() );
+    //the chain is stored from the target frame backwards
+    BOOST_CHECK_EQUAL( false, chain[0].inverse );
+    BOOST_CHECK_EQUAL( true, chain[1].inverse );
+
+    Eigen::Affine3d expected = body2Robot.getTransform() * body2Laser.getTransform().inverse();
+    Eigen::Affine3d result(Eigen::Affine3d::Identity());
+    for(std::vector<TransformationEdge>::const_iterator it = chain.begin(); it != chain.end(); it++)
+    {
+        TransformationType tr;
+        BOOST_REQUIRE( it->element->getTransformation(base::Time(), false, tr) );
+        Eigen::Affine3d step(tr);
+        result = result * (it->inverse ? step.inverse() : step);
+    }
+    BOOST_CHECK( expected.isApprox(result) );
+    
+    std::pair<int, int> counts = tree.getElementsCount();
+    BOOST_CHECK_EQUAL( 2, counts.first );
+    BOOST_CHECK_EQUAL( 0, counts.second );
+}
+
+int changedCallbackCount;
+
+void counting_callback(const base::Time &time, const transformer::Transformation &tr)
+{
+    changedCallbackCount++;
+}
+
+BOOST_AUTO_TEST_CASE( incremental_chain_resolution )
+{
+    transformer::Transformer tf;
+    changedCallbackCount = 0;
+
+    TransformationType robot2Laser;
+    robot2Laser.sourceFrame = "robot";
+    robot2Laser.targetFrame = "laser";
+    robot2Laser.orientation = Eigen::Quaterniond::Identity();
+    robot2Laser.position = Eigen::Vector3d(1,0,0);
+
+    Transformation &laser = tf.registerTransformation("laser", "robot");
+    Transformation &camera = tf.registerTransformation("camera", "body");
+    tf.registerTransformCallback(laser, &counting_callback);
+
+    robot2Laser.time = base::Time::fromSeconds(1);
+    tf.pushDynamicTransformation(robot2Laser);
+
+    //edges in an unrelated component must not touch the laser chain
+    TransformationType camera2Mount(robot2Laser);
+    camera2Mount.sourceFrame = "camera";
+    camera2Mount.targetFrame = "mount";
+    tf.pushStaticTransformation(camera2Mount);
+
+    Eigen::Affine3d result;
+    BOOST_CHECK( !camera.get(base::Time::fromSeconds(1), result) );
+
+    TransformationType mount2Body(robot2Laser);
+    mount2Body.sourceFrame = "mount";
+    mount2Body.targetFrame = "body";
+    tf.pushStaticTransformation(mount2Body);
+
+    BOOST_CHECK( camera.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(2,0,0)) );
+    BOOST_CHECK_EQUAL( 2, camera.getStatus().chain_length );
+
+    robot2Laser.time = base::Time::fromSeconds(2);
+    tf.pushDynamicTransformation(robot2Laser);
+    while(tf.step())
+        ;
+
+    BOOST_CHECK_EQUAL( 2, changedCallbackCount );
+    BOOST_CHECK( laser.get(base::Time::fromSeconds(2), result) );
+}
+
+TransformationType makeTransform(const std::string &source, const std::string &target, double angle, const Eigen::Vector3d &position)
+{
+    TransformationType tr;
+    tr.sourceFrame = source;
+    tr.targetFrame = target;
+    tr.orientation = Eigen::Quaterniond(Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitZ()));
+    tr.position = position;
+    return tr;
+}
+
+BOOST_AUTO_TEST_CASE( tree_mode )
+{
+    transformer::Transformer chainTf;
+    transformer::Transformer treeTf;
+    treeTf.setTreeMode(true);
+    BOOST_CHECK( treeTf.isTreeMode() );
+
+    Transformation &chainLaser2Camera = chainTf.registerTransformation("laser", "camera");
+    Transformation &chainLaser2Map = chainTf.registerTransformation("laser", "map");
+    Transformation &treeLaser2Camera = treeTf.registerTransformation("laser", "camera");
+    Transformation &treeLaser2Map = treeTf.registerTransformation("laser", "map");
+
+    transformer::Transformer *tfs[] = { &chainTf, &treeTf };
+    for(int i = 0; i < 2; i++)
+    {
+        tfs[i]->pushStaticTransformation(makeTransform("body", "odometry", 0.1, Eigen::Vector3d(0,0,1)));
+        tfs[i]->pushStaticTransformation(makeTransform("laser", "body", 0.3, Eigen::Vector3d(1,0,0.5)));
+        tfs[i]->pushStaticTransformation(makeTransform("body", "camera", -0.4, Eigen::Vector3d(0.2,0.1,0)));
+
+        TransformationType odometry2Map = makeTransform("odometry", "map", 1.0, Eigen::Vector3d(5,2,0));
+        odometry2Map.time = base::Time::fromSeconds(1);
+        tfs[i]->pushDynamicTransformation(odometry2Map);
+        while(tfs[i]->step())
+            ;
+    }
+
+    base::Time time = base::Time::fromSeconds(1);
+    Eigen::Affine3d expected, result;
+    BOOST_REQUIRE( chainLaser2Camera.get(time, expected) );
+    BOOST_REQUIRE( treeLaser2Camera.get(time, result) );
+    BOOST_CHECK( expected.isApprox(result) );
+    BOOST_CHECK_EQUAL( 2, treeLaser2Camera.getStatus().chain_length );
+
+    BOOST_REQUIRE( chainLaser2Map.get(time, expected) );
+    BOOST_REQUIRE( treeLaser2Map.get(time, result) );
+    BOOST_CHECK( expected.isApprox(result) );
+    BOOST_CHECK_EQUAL( 3, treeLaser2Map.getStatus().chain_length );
+
+    //a missing dynamic sample above the common ancestor does not matter
+    transformer::Transformer tf;
+    tf.setTreeMode(true);
+    Transformation &odometry2Body = tf.registerTransformation("odometry", "body");
+    Transformation &laser2Camera = tf.registerTransformation("laser", "camera");
+    tf.pushStaticTransformation(makeTransform("laser", "body", 0.3, Eigen::Vector3d(1,0,0.5)));
+    tf.pushStaticTransformation(makeTransform("body", "camera", -0.4, Eigen::Vector3d(0.2,0.1,0)));
+    TransformationType odometry2BodySample = makeTransform("odometry", "body", 1.0, Eigen::Vector3d(5,2,0));
+    odometry2BodySample.time = base::Time::fromSeconds(1);
+    tf.pushDynamicTransformation(odometry2BodySample);
+    BOOST_CHECK( !odometry2Body.get(time, result) );
+    BOOST_REQUIRE( chainLaser2Camera.get(time, expected) );
+    BOOST_REQUIRE( laser2Camera.get(time, result) );
+    BOOST_CHECK( expected.isApprox(result) );
+}
+
+BOOST_AUTO_TEST_CASE( chain_search_on_cyclic_graph )
+{
+    transformer::TransformationTree tree;
+
+    //a ladder of frames with two parallel edges between each neighbours,
+    //which makes the number of loop-free paths grow exponentially
+    for(int i = 0; i < 30; i++)
+    {
+        std::ostringstream source, target;
+        source << "frame" << i;
+        target << "frame" << i + 1;
+        TransformationType tr = makeTransform(source.str(), target.str(), 0, Eigen::Vector3d(1,0,0));
+        tree.addTransformation(new StaticTransformationElement(source.str(), target.str(), tr));
+        tree.addTransformation(new StaticTransformationElement(source.str(), target.str(), tr));
+    }
+
+    for(int i = 0; i < 3; i++)
+    {
+        std::vector<TransformationEdge> chain;
+        BOOST_REQUIRE( tree.getTransformationChain(std::string("frame15"), std::string("frame2"), chain) );
+        BOOST_REQUIRE_EQUAL( 13, chain.size() );
+
+        Eigen::Affine3d result(Eigen::Affine3d::Identity());
+        for(std::vector<TransformationEdge>::const_iterator it = chain.begin(); it != chain.end(); it++)
+        {
+            TransformationType tr;
+            BOOST_REQUIRE( it->element->getTransformation(base::Time(), false, tr) );
+            Eigen::Affine3d step(tr);
+            result = result * (it->inverse ? step.inverse() : step);
+        }
+        BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(-13,0,0)) );
+    }
+
+    std::vector<TransformationEdge> chain;
+    BOOST_CHECK( !tree.getTransformationChain(std::string("frame0"), std::string("frame25"), chain) );
+}
+
+BOOST_AUTO_TEST_CASE( cost_based_chain_selection )
+{
+    transformer::Transformer tf;
+    tf.setCostBasedChainSelection(true);
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+
+    tf.pushStaticTransformation(makeTransform("laser", "imu", 0, Eigen::Vector3d(1,0,0)));
+
+    //a slow direct producer and a fast one going through a static link
+    TransformationType slow = makeTransform("laser", "map", 0, Eigen::Vector3d(0,0,0));
+    TransformationType fast = makeTransform("imu", "map", 0, Eigen::Vector3d(0,0,0));
+    for(int i = 1; i <= 300; i++)
+    {
+        fast.time = base::Time::fromMilliseconds(i);
+        tf.pushDynamicTransformation(fast);
+        if(i % 100 == 0)
+        {
+            slow.time = base::Time::fromMilliseconds(i);
+            tf.pushDynamicTransformation(slow);
+        }
+    }
+    BOOST_CHECK_EQUAL( 2, laser2Map.getStatus().chain_length );
+
+    tf.setCostBasedChainSelection(false);
+    BOOST_CHECK_EQUAL( 1, laser2Map.getStatus().chain_length );
+}
+
+BOOST_AUTO_TEST_CASE( batched_topology_update )
+{
+    transformer::Transformer tf;
+    changedCallbackCount = 0;
+
+    tf.beginTopologyUpdate();
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+    tf.registerTransformCallback(laser2Map, &counting_callback);
+
+    std::vector<TransformationType> statics;
+    statics.push_back(makeTransform("laser", "body", 0, Eigen::Vector3d(1,0,0)));
+    statics.push_back(makeTransform("body", "odometry", 0, Eigen::Vector3d(1,0,0)));
+    statics.push_back(makeTransform("odometry", "map", 0, Eigen::Vector3d(1,0,0)));
+    tf.pushStaticTransformations(statics);
+
+    //nothing gets resolved before the outermost commit
+    Eigen::Affine3d result;
+    BOOST_CHECK( !laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK_EQUAL( 0, changedCallbackCount );
+    tf.commitTopologyUpdate();
+
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(3,0,0)) );
+    BOOST_CHECK_THROW( tf.commitTopologyUpdate(), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( static_transformation_update )
+{
+    transformer::Transformer tf;
+    changedCallbackCount = 0;
+
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+    tf.pushStaticTransformation(makeTransform("laser", "body", 0, Eigen::Vector3d(1,0,0)));
+    tf.pushStaticTransformation(makeTransform("body", "map", 0, Eigen::Vector3d(1,0,0)));
+    tf.registerTransformCallback(laser2Map, &counting_callback);
+
+    tf.pushStaticTransformation(makeTransform("laser", "body", 0, Eigen::Vector3d(2,0,0)));
+    BOOST_CHECK_EQUAL( 1, changedCallbackCount );
+    //updates given in the other direction are inverted
+    tf.pushStaticTransformation(makeTransform("map", "body", 0, Eigen::Vector3d(-3,0,0)));
+    BOOST_CHECK_EQUAL( 2, changedCallbackCount );
+
+    Eigen::Affine3d result;
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(5,0,0)) );
+    BOOST_CHECK_EQUAL( 2, laser2Map.getStatus().chain_length );
+}
+
+BOOST_AUTO_TEST_CASE( dynamic_transformation_removal )
+{
+    transformer::Transformer tf;
+    Transformation &marker2Map = tf.registerTransformation("marker", "map");
+    Transformation &body2Map = tf.registerTransformation("body", "map");
+
+    TransformationType marker2Body = makeTransform("marker", "body", 0, Eigen::Vector3d(1,0,0));
+    TransformationType body2MapSample = makeTransform("body", "map", 0, Eigen::Vector3d(1,0,0));
+    marker2Body.time = base::Time::fromSeconds(1);
+    body2MapSample.time = base::Time::fromSeconds(1);
+    tf.pushDynamicTransformation(marker2Body);
+    tf.pushDynamicTransformation(body2MapSample);
+    BOOST_CHECK_EQUAL( 2, marker2Map.getStatus().chain_length );
+
+    BOOST_CHECK( tf.removeDynamicTransformation("marker", "body") );
+    BOOST_CHECK( !tf.removeDynamicTransformation("marker", "body") );
+    //unknown frames are not registered by the removal
+    BOOST_CHECK( !tf.removeDynamicTransformation("camera", "body") );
+    BOOST_CHECK( !tf.removeDynamicTransformation("body", "camera") );
+    BOOST_CHECK_EQUAL( 0, marker2Map.getStatus().chain_length );
+    BOOST_CHECK_EQUAL( 1, body2Map.getStatus().chain_length );
+
+    Eigen::Affine3d result;
+    BOOST_CHECK( !marker2Map.get(base::Time::fromSeconds(1), result) );
+
+    //markers that stop being observed get evicted by the next step
+    tf.setIdleTimeout(base::Time::fromSeconds(2));
+    tf.pushDynamicTransformation(marker2Body);
+    BOOST_CHECK_EQUAL( 2, marker2Map.getStatus().chain_length );
+    for(int i = 2; i < 6; i++)
+    {
+        body2MapSample.time = base::Time::fromSeconds(i);
+        tf.pushDynamicTransformation(body2MapSample);
+    }
+    BOOST_CHECK_EQUAL( 2, marker2Map.getStatus().chain_length );
+    while(tf.step())
+        ;
+    BOOST_CHECK_EQUAL( 0, marker2Map.getStatus().chain_length );
+    BOOST_CHECK_EQUAL( 1, body2Map.getStatus().chain_length );
+}
+
+transformer::Transformer *idleTransformer;
+int idleChainLength;
+
+void idle_callback(const base::Time &ts, const base::samples::LaserScan &value, const Transformation &t)
+{
+    TransformationType body2Map = makeTransform("body", "map", 0, Eigen::Vector3d(1,0,0));
+    body2Map.time = base::Time::fromSeconds(10);
+    idleTransformer->pushDynamicTransformation(body2Map);
+    idleChainLength = t.getStatus().chain_length;
+}
+
+BOOST_AUTO_TEST_CASE( idle_eviction_in_callback )
+{
+    transformer::Transformer tf;
+    idleTransformer = &tf;
+    tf.setIdleTimeout(base::Time::fromSeconds(2));
+    Transformation &marker2Map = tf.registerTransformation("marker", "map");
+    int ls_idx = tf.registerDataStreamWithTransform<base::samples::LaserScan>(base::Time::fromSeconds(1), marker2Map, &idle_callback);
+
+    TransformationType marker2Body = makeTransform("marker", "body", 0, Eigen::Vector3d(1,0,0));
+    TransformationType body2Map = makeTransform("body", "map", 0, Eigen::Vector3d(1,0,0));
+    marker2Body.time = base::Time::fromSeconds(1);
+    body2Map.time = base::Time::fromSeconds(1);
+    tf.pushDynamicTransformation(marker2Body);
+    tf.pushDynamicTransformation(body2Map);
+    tf.pushData(ls_idx, base::Time::fromSeconds(2), base::samples::LaserScan());
+
+    //a sample pushed from a callback makes the marker idle, but it is only
+    //evicted once the callback returned
+    idleChainLength = -1;
+    while(idleChainLength < 0 && tf.step())
+        ;
+    BOOST_CHECK_EQUAL( 2, idleChainLength );
+    BOOST_CHECK_EQUAL( 2, marker2Map.getStatus().chain_length );
+    tf.step();
+    BOOST_CHECK_EQUAL( 0, marker2Map.getStatus().chain_length );
+    BOOST_CHECK( !tf.removeDynamicTransformation("marker", "body") );
+}
+
+BOOST_AUTO_TEST_CASE( frame_mapping_table )
+{
+    transformer::Transformer tf;
+    tf.pushStaticTransformation(makeTransform("velodyne", "body", 0, Eigen::Vector3d(1,0,0)));
+    tf.pushStaticTransformation(makeTransform("body", "world", 0, Eigen::Vector3d(1,0,0)));
+
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+    Transformation &body2Map = tf.registerTransformation("body", "map");
+
+    std::map<std::string, std::string> mappings;
+    mappings["laser"] = "velodyne";
+    mappings["map"] = "world";
+    tf.setFrameMappings(mappings);
+
+    BOOST_CHECK_EQUAL( "velodyne", laser2Map.getSourceFrame() );
+    BOOST_CHECK_EQUAL( "world", laser2Map.getTargetFrame() );
+    BOOST_CHECK_EQUAL( 2, laser2Map.getStatus().chain_length );
+    BOOST_CHECK_EQUAL( 1, body2Map.getStatus().chain_length );
+
+    //the table also applies to transformations registered afterwards
+    Transformation &laser2Body = tf.registerTransformation("laser", "body");
+    BOOST_CHECK_EQUAL( 1, laser2Body.getStatus().chain_length );
+
+    //and mappings can be removed
+    tf.setFrameMapping("map", "");
+    BOOST_CHECK_EQUAL( "map", laser2Map.getTargetFrame() );
+    BOOST_CHECK_EQUAL( 0, laser2Map.getStatus().chain_length );
+    BOOST_CHECK_EQUAL( 1, laser2Body.getStatus().chain_length );
+}
+
+BOOST_AUTO_TEST_CASE( static_chain_folding )
+{
+    transformer::Transformer tf;
+    Transformation &laser2Body = tf.registerTransformation("laser", "body");
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+
+    TransformationType laser2Mount = makeTransform("laser", "mount", M_PI / 2, Eigen::Vector3d(1,0,0));
+    TransformationType body2Mount = makeTransform("body", "mount", 0, Eigen::Vector3d(0,2,0));
+    TransformationType body2MapSample = makeTransform("body", "map", M_PI / 2, Eigen::Vector3d(0,0,3));
+    body2MapSample.time = base::Time::fromSeconds(1);
+    tf.pushStaticTransformation(laser2Mount);
+    tf.pushStaticTransformation(body2Mount);
+    tf.pushDynamicTransformation(body2MapSample);
+    while(tf.step())
+        ;
+
+    Eigen::Affine3d expectedStatic = Eigen::Affine3d(body2Mount).inverse() * Eigen::Affine3d(laser2Mount);
+    Eigen::Affine3d result;
+    BOOST_REQUIRE( laser2Body.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(expectedStatic) );
+
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(Eigen::Affine3d(body2MapSample) * expectedStatic) );
+
+    //updates of a static element invalidate the folded part of the chain
+    laser2Mount.position = Eigen::Vector3d(5,0,0);
+    tf.pushStaticTransformation(laser2Mount);
+    expectedStatic = Eigen::Affine3d(body2Mount).inverse() * Eigen::Affine3d(laser2Mount);
+    BOOST_REQUIRE( laser2Body.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(expectedStatic) );
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(Eigen::Affine3d(body2MapSample) * expectedStatic) );
+}
+
+BOOST_AUTO_TEST_CASE( pose_evaluation )
+{
+    transformer::Transformer tf;
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+
+    TransformationType body2Laser = makeTransform("body", "laser", M_PI / 4, Eigen::Vector3d(1,2,0));
+    TransformationType body2MapSample = makeTransform("body", "map", M_PI / 3, Eigen::Vector3d(0,0,3));
+    body2MapSample.time = base::Time::fromSeconds(1);
+    tf.pushStaticTransformation(body2Laser);
+    tf.pushDynamicTransformation(body2MapSample);
+    while(tf.step())
+        ;
+
+    //the pose based evaluation matches the full transformations
+    std::vector<TransformationType> fullChain;
+    std::vector<Eigen::Affine3d> poseChain;
+    BOOST_REQUIRE( laser2Map.getChain(base::Time::fromSeconds(1), fullChain) );
+    BOOST_REQUIRE( laser2Map.getChain(base::Time::fromSeconds(1), poseChain) );
+    BOOST_REQUIRE_EQUAL( fullChain.size(), poseChain.size() );
+    for(size_t i = 0; i < fullChain.size(); i++)
+        BOOST_CHECK( poseChain[i].isApprox(fullChain[i].getTransform()) );
+
+    Eigen::Affine3d result;
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(Eigen::Affine3d(body2MapSample) * Eigen::Affine3d(body2Laser).inverse()) );
+}
+
+BOOST_AUTO_TEST_CASE( cached_rigid_inverse )
+{
+    TransformationType laser2Body = makeTransform("laser", "body", M_PI / 3, Eigen::Vector3d(1,2,3));
+    TransformationType inverted(laser2Body);
+    invertTransformation(inverted);
+    BOOST_CHECK_EQUAL( "body", inverted.sourceFrame );
+    BOOST_CHECK( inverted.getTransform().isApprox(laser2Body.getTransform().inverse()) );
+
+    StaticTransformationElement element("laser", "body", laser2Body);
+    InverseTransformationElement inverse(&element);
+    Eigen::Isometry3d pose;
+    BOOST_REQUIRE( inverse.getPose(base::Time::fromSeconds(1), false, pose) );
+    BOOST_CHECK( pose.matrix().isApprox(inverted.getTransform().matrix()) );
+    BOOST_REQUIRE( inverse.getPose(base::Time::fromSeconds(1), false, pose) );
+    BOOST_CHECK( pose.matrix().isApprox(inverted.getTransform().matrix()) );
+
+    //updates of the wrapped element are seen through the version counter
+    unsigned version = inverse.getVersion();
+    laser2Body.position = Eigen::Vector3d(0,0,1);
+    element.setTransformation(laser2Body);
+    BOOST_CHECK( version != inverse.getVersion() );
+    BOOST_REQUIRE( inverse.getPose(base::Time::fromSeconds(1), false, pose) );
+    BOOST_CHECK( pose.matrix().isApprox(laser2Body.getTransform().inverse().matrix()) );
+}
+
+BOOST_AUTO_TEST_CASE( memoized_chain_evaluation )
+{
+    transformer::NonAligningTransformer tf;
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+    unsigned version = laser2Map.getVersion();
+
+    TransformationType laser2Body = makeTransform("laser", "body", 0, Eigen::Vector3d(1,0,0));
+    TransformationType body2Odometry = makeTransform("body", "odometry", M_PI / 2, Eigen::Vector3d(0,1,0));
+    TransformationType odometry2Map = makeTransform("odometry", "map", 0, Eigen::Vector3d(0,0,1));
+    body2Odometry.time = base::Time::fromSeconds(1);
+    odometry2Map.time = base::Time::fromSeconds(1);
+    tf.pushStaticTransformation(laser2Body);
+    tf.pushDynamicTransformation(body2Odometry);
+    tf.pushDynamicTransformation(odometry2Map);
+    BOOST_CHECK( laser2Map.hasChangedSince(version) );
+
+    Eigen::Affine3d result;
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(Eigen::Affine3d(odometry2Map) * Eigen::Affine3d(body2Odometry) * Eigen::Affine3d(laser2Body)) );
+
+    version = laser2Map.getVersion();
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( !laser2Map.hasChangedSince(version) );
+
+    //a change of a single element is seen by a query at the same time
+    body2Odometry.position = Eigen::Vector3d(0,5,0);
+    tf.pushDynamicTransformation(body2Odometry);
+    BOOST_CHECK( laser2Map.hasChangedSince(version) );
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(Eigen::Affine3d(odometry2Map) * Eigen::Affine3d(body2Odometry) * Eigen::Affine3d(laser2Body)) );
+
+    odometry2Map.position = Eigen::Vector3d(0,0,7);
+    tf.pushDynamicTransformation(odometry2Map);
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(Eigen::Affine3d(odometry2Map) * Eigen::Affine3d(body2Odometry) * Eigen::Affine3d(laser2Body)) );
+}
+
+class SegmentCountingTransformer : public transformer::NonAligningTransformer
+{
+public:
+    size_t getSegmentCount() const
+    {
+        return segmentCache->getSegmentCount();
+    }
+};
+
+BOOST_AUTO_TEST_CASE( shared_chain_segments )
+{
+    SegmentCountingTransformer tf;
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+    Transformation &camera2Map = tf.registerTransformation("camera", "map");
+
+    TransformationType laser2Body = makeTransform("laser", "body", 0, Eigen::Vector3d(1,0,0));
+    TransformationType camera2Body = makeTransform("camera", "body", M_PI / 2, Eigen::Vector3d(0,1,0));
+    TransformationType body2Odometry = makeTransform("body", "odometry", M_PI / 4, Eigen::Vector3d(0,0,1));
+    TransformationType odometry2Map = makeTransform("odometry", "map", 0, Eigen::Vector3d(2,0,0));
+    body2Odometry.time = base::Time::fromSeconds(1);
+    odometry2Map.time = base::Time::fromSeconds(1);
+    tf.pushStaticTransformation(laser2Body);
+    tf.pushStaticTransformation(camera2Body);
+    tf.pushDynamicTransformation(body2Odometry);
+    tf.pushDynamicTransformation(odometry2Map);
+
+    //odometry2map and body2odometry are shared, the static parts are not
+    BOOST_CHECK_EQUAL( 4, tf.getSegmentCount() );
+
+    Eigen::Affine3d suffix = Eigen::Affine3d(odometry2Map) * Eigen::Affine3d(body2Odometry);
+    Eigen::Affine3d result;
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(suffix * Eigen::Affine3d(laser2Body)) );
+    BOOST_REQUIRE( camera2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(suffix * Eigen::Affine3d(camera2Body)) );
+
+    //an update of a shared element is seen by both transformations
+    odometry2Map.position = Eigen::Vector3d(0,3,0);
+    tf.pushDynamicTransformation(odometry2Map);
+    suffix = Eigen::Affine3d(odometry2Map) * Eigen::Affine3d(body2Odometry);
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(suffix * Eigen::Affine3d(laser2Body)) );
+    BOOST_REQUIRE( camera2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.isApprox(suffix * Eigen::Affine3d(camera2Body)) );
+
+    //segments go away with the chains using them
+    BOOST_CHECK( tf.removeDynamicTransformation("body", "odometry") );
+    BOOST_CHECK_EQUAL( 0, tf.getSegmentCount() );
+}
+
+BOOST_AUTO_TEST_CASE( rigid_composition_traits )
+{
+    std::vector<Eigen::Affine3d, Eigen::aligned_allocator<Eigen::Affine3d> > affines;
+    std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> > isometries;
+    std::vector<QuaternionTransform, Eigen::aligned_allocator<QuaternionTransform> > quaternions;
+    std::vector<DualQuaternion, Eigen::aligned_allocator<DualQuaternion> > dualQuaternions;
+    for(int i = 0; i < 5; i++)
+    {
+        TransformationType tr = makeTransform("a", "b", 0.3 * i, Eigen::Vector3d(i, 1, -i));
+        tr.orientation = tr.orientation * Eigen::Quaterniond(Eigen::AngleAxisd(0.2, Eigen::Vector3d::UnitX()));
+        Eigen::Isometry3d pose;
+        toPose(tr, pose);
+        affines.push_back(Eigen::Affine3d(pose));
+        isometries.push_back(pose);
+        quaternions.push_back(QuaternionTransform(pose));
+        dualQuaternions.push_back(DualQuaternion(pose));
+    }
+
+    Eigen::Affine3d expected(Eigen::Affine3d::Identity());
+    Eigen::Isometry3d isometry(Eigen::Isometry3d::Identity());
+    QuaternionTransform quaternion;
+    DualQuaternion dualQuaternion;
+    for(size_t i = 0; i < affines.size(); i++)
+    {
+        expected = expected * affines[i];
+        Eigen::Isometry3d composedIsometry;
+        CompositionTraits<Eigen::Isometry3d>::compose(isometry, isometries[i], composedIsometry);
+        isometry = composedIsometry;
+        QuaternionTransform composedQuaternion;
+        CompositionTraits<QuaternionTransform>::compose(quaternion, quaternions[i], composedQuaternion);
+        quaternion = composedQuaternion;
+        DualQuaternion composedDualQuaternion;
+        CompositionTraits<DualQuaternion>::compose(dualQuaternion, dualQuaternions[i], composedDualQuaternion);
+        dualQuaternion = composedDualQuaternion;
+    }
+    BOOST_CHECK( isometry.matrix().isApprox(expected.matrix()) );
+    BOOST_CHECK( quaternion.toIsometry().matrix().isApprox(expected.matrix()) );
+    BOOST_CHECK( dualQuaternion.toIsometry().matrix().isApprox(expected.matrix()) );
+    CompositionTraits<Eigen::Isometry3d>::composeChain(&isometries[0], isometries.size(), isometry);
+    BOOST_CHECK( isometry.matrix().isApprox(expected.matrix()) );
+    CompositionTraits<QuaternionTransform>::composeChain(&quaternions[0], quaternions.size(), quaternion);
+    BOOST_CHECK( quaternion.toIsometry().matrix().isApprox(expected.matrix()) );
+    CompositionTraits<DualQuaternion>::composeChain(&dualQuaternions[0], dualQuaternions.size(), dualQuaternion);
+    BOOST_CHECK( dualQuaternion.toIsometry().matrix().isApprox(expected.matrix()) );
+    BOOST_CHECK( dualQuaternion.inverse().toIsometry().matrix().isApprox(expected.inverse().matrix()) );
+
+    //the rigid types can be used as result of a transformation
+    transformer::Transformer tf;
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+    TransformationType laser2Body = makeTransform("laser", "body", 0.5, Eigen::Vector3d(1,0,0));
+    TransformationType body2Map = makeTransform("body", "map", 0.7, Eigen::Vector3d(0,2,0));
+    tf.pushStaticTransformation(laser2Body);
+    tf.pushStaticTransformation(body2Map);
+    expected = Eigen::Affine3d(body2Map) * Eigen::Affine3d(laser2Body);
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), quaternion) );
+    BOOST_CHECK( quaternion.toIsometry().matrix().isApprox(expected.matrix()) );
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), dualQuaternion) );
+    BOOST_CHECK( dualQuaternion.toIsometry().matrix().isApprox(expected.matrix()) );
+
+    //dynamic chains with inverted edges are composed edge by edge
+    transformer::NonAligningTransformer nonAligned;
+    Transformation &laser2World = nonAligned.registerTransformation("laser", "world");
+    TransformationType world2Map = makeTransform("world", "map", -0.4, Eigen::Vector3d(3,0,1));
+    body2Map.time = base::Time::fromSeconds(1);
+    world2Map.time = base::Time::fromSeconds(1);
+    nonAligned.pushStaticTransformation(laser2Body);
+    nonAligned.pushDynamicTransformation(body2Map);
+    nonAligned.pushDynamicTransformation(world2Map);
+    expected = Eigen::Affine3d(world2Map).inverse() * Eigen::Affine3d(body2Map) * Eigen::Affine3d(laser2Body);
+    Eigen::Affine3d affine;
+    BOOST_REQUIRE( laser2World.get(base::Time::fromSeconds(1), affine) );
+    BOOST_CHECK( affine.isApprox(expected) );
+    BOOST_REQUIRE( laser2World.get(base::Time::fromSeconds(1), quaternion) );
+    BOOST_CHECK( quaternion.toIsometry().matrix().isApprox(expected.matrix()) );
+    BOOST_REQUIRE( laser2World.get(base::Time::fromSeconds(1), dualQuaternion) );
+    BOOST_CHECK( dualQuaternion.toIsometry().matrix().isApprox(expected.matrix()) );
+    BOOST_CHECK( !laser2World.get(base::Time::fromSeconds(2), quaternion, true) );
+    BOOST_CHECK_EQUAL( 1u, laser2World.getStatus().failed_interpolation_impossible );
+
+    //chains longer than a composition block
+    transformer::NonAligningTransformer longChain;
+    Transformation &link2Base = longChain.registerTransformation("link0", "link11");
+    expected.setIdentity();
+    for(int i = 0; i < 11; i++)
+    {
+        std::ostringstream source, target;
+        source << "link" << i;
+        target << "link" << i + 1;
+        TransformationType link = makeTransform(source.str(), target.str(), 0.1 * i, Eigen::Vector3d(1, 0.1 * i, 0));
+        link.time = base::Time::fromSeconds(1);
+        longChain.pushDynamicTransformation(link);
+        expected = Eigen::Affine3d(link) * expected;
+    }
+    BOOST_REQUIRE( link2Base.get(base::Time::fromSeconds(1), quaternion) );
+    BOOST_CHECK( quaternion.toIsometry().matrix().isApprox(expected.matrix()) );
+    BOOST_REQUIRE( link2Base.get(base::Time::fromSeconds(1), dualQuaternion) );
+    BOOST_CHECK( dualQuaternion.toIsometry().matrix().isApprox(expected.matrix()) );
+}
+
+std::vector<base::Time> batchTimes;
+std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> > batchResults;
+std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> > singleResults;
+bool batchValid[5];
+bool singleValid[5];
+size_t batchValidCount;
+
+void batch_callback(const base::Time &ts, const base::samples::LaserScan &value, const Transformation &t)
+{
+    batchResults.resize(batchTimes.size());
+    singleResults.resize(batchTimes.size());
+    batchValidCount = t.get(&batchTimes[0], batchTimes.size(), &batchResults[0], batchValid, true);
+    for(size_t i = 0; i < batchTimes.size(); i++)
+    {
+        Eigen::Affine3d tr;
+        //the single get rejects times outside of the two samples
+        singleValid[i] = batchTimes[i] >= base::Time::fromMicroseconds(5000) &&
+            batchTimes[i] < base::Time::fromMicroseconds(15000) &&
+            t.get(batchTimes[i], tr, true);
+        singleResults[i].matrix() = tr.matrix();
+    }
+}
+
+BOOST_AUTO_TEST_CASE( batch_get )
+{
+    transformer::Transformer tf;
+    Transformation &t = tf.registerTransformation("laser", "map");
+    int ls_idx = tf.registerDataStreamWithTransform<base::samples::LaserScan>(base::Time::fromMicroseconds(10000), t, &batch_callback);
+    base::samples::LaserScan ls;
+    tf.pushData(ls_idx, base::Time::fromMicroseconds(10000), ls);
+
+    tf.pushStaticTransformation(makeTransform("laser", "body", M_PI / 2, Eigen::Vector3d(1,0,0)));
+    TransformationType body2Map = makeTransform("body", "map", 0, Eigen::Vector3d(0,0,0));
+    body2Map.time = base::Time::fromMicroseconds(5000);
+    tf.pushDynamicTransformation(body2Map);
+    body2Map = makeTransform("body", "map", M_PI / 2, Eigen::Vector3d(10,0,0));
+    body2Map.time = base::Time::fromMicroseconds(15000);
+    tf.pushDynamicTransformation(body2Map);
+
+    batchTimes.clear();
+    batchTimes.push_back(base::Time::fromMicroseconds(1000));
+    batchTimes.push_back(base::Time::fromMicroseconds(5000));
+    batchTimes.push_back(base::Time::fromMicroseconds(7500));
+    batchTimes.push_back(base::Time::fromMicroseconds(10000));
+    batchTimes.push_back(base::Time::fromMicroseconds(20000));
+    batchValidCount = 0;
+    while(tf.step())
+        ;
+
+    BOOST_CHECK_EQUAL( 3, batchValidCount );
+    for(size_t i = 0; i < batchTimes.size(); i++)
+    {
+        BOOST_CHECK_EQUAL( singleValid[i], batchValid[i] );
+        if(batchValid[i] && singleValid[i])
+            BOOST_CHECK( batchResults[i].matrix().isApprox(singleResults[i].matrix()) );
+    }
+
+    //7500us is a quarter of the way between the two samples
+    BOOST_REQUIRE( batchValid[2] );
+    Eigen::Isometry3d body2MapPose(Eigen::AngleAxisd(M_PI / 8, Eigen::Vector3d::UnitZ()));
+    body2MapPose.translation() = Eigen::Vector3d(2.5,0,0);
+    Eigen::Isometry3d laser2BodyPose;
+    transformer::toPose(makeTransform("laser", "body", M_PI / 2, Eigen::Vector3d(1,0,0)), laser2BodyPose);
+    BOOST_CHECK( batchResults[2].matrix().isApprox((body2MapPose * laser2BodyPose).matrix()) );
+}
+
+BOOST_AUTO_TEST_CASE( point_transform_kernels )
+{
+    TransformationType laser2Body = makeTransform("laser", "body", 0.3, Eigen::Vector3d(1,2,3));
+    laser2Body.orientation = laser2Body.orientation * Eigen::Quaterniond(Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitY()));
+    Eigen::Isometry3d pose;
+    toPose(laser2Body, pose);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    BOOST_CHECK_EQUAL( __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"), hasVectorPointKernels() );
+#endif
+    if(!hasVectorPointKernels())
+        BOOST_TEST_MESSAGE("no vector point kernels on this machine, only testing the scalar code");
+
+    //odd count, so that the scalar tail of the vector kernels gets used
+    const size_t count = 19;
+    std::vector<double> aos(3 * count), x(count), y(count), z(count);
+    std::vector<float> aosf(3 * count), xf(count), yf(count), zf(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        x[i] = aos[3 * i] = xf[i] = aosf[3 * i] = 0.5 * i;
+        y[i] = aos[3 * i + 1] = yf[i] = aosf[3 * i + 1] = 1.0 - i;
+        z[i] = aos[3 * i + 2] = zf[i] = aosf[3 * i + 2] = 0.25 * i * i;
+    }
+    std::vector<double> expected(aos);
+    for(size_t i = 0; i < count; i++)
+    {
+        Eigen::Vector3d p = pose * Eigen::Vector3d(aos[3 * i], aos[3 * i + 1], aos[3 * i + 2]);
+        expected[3 * i] = p.x();
+        expected[3 * i + 1] = p.y();
+        expected[3 * i + 2] = p.z();
+    }
+
+    //in place
+    transformPoints(pose, &aos[0], &aos[0], count);
+    transformPoints(pose, &aosf[0], &aosf[0], count);
+    transformPoints(pose, &x[0], &y[0], &z[0], &x[0], &y[0], &z[0], count);
+    transformPoints(pose, &xf[0], &yf[0], &zf[0], &xf[0], &yf[0], &zf[0], count);
+    for(size_t i = 0; i < 3 * count; i++)
+    {
+        BOOST_CHECK_CLOSE( expected[i] + 100, aos[i] + 100, 1e-9 );
+        BOOST_CHECK_CLOSE( expected[i] + 100, aosf[i] + 100, 1e-4 );
+    }
+    for(size_t i = 0; i < count; i++)
+    {
+        BOOST_CHECK_CLOSE( expected[3 * i] + 100, x[i] + 100, 1e-9 );
+        BOOST_CHECK_CLOSE( expected[3 * i + 1] + 100, y[i] + 100, 1e-9 );
+        BOOST_CHECK_CLOSE( expected[3 * i + 2] + 100, z[i] + 100, 1e-9 );
+        BOOST_CHECK_CLOSE( expected[3 * i] + 100, xf[i] + 100, 1e-4 );
+        BOOST_CHECK_CLOSE( expected[3 * i + 1] + 100, yf[i] + 100, 1e-4 );
+        BOOST_CHECK_CLOSE( expected[3 * i + 2] + 100, zf[i] + 100, 1e-4 );
+    }
+
+    //de-skewing with a static chain is a plain transformation
+    transformer::Transformer tf;
+    Transformation &laser2BodyTr = tf.registerTransformation("laser", "body");
+    std::vector<double> deskewed(3 * count);
+    for(size_t i = 0; i < count; i++)
+    {
+        x[i] = 0.5 * i;
+        y[i] = 1.0 - i;
+        z[i] = 0.25 * i * i;
+    }
+    BOOST_CHECK( !deskewPoints(laser2BodyTr, base::Time::fromSeconds(1), base::Time::fromSeconds(2), 4, &x[0], &y[0], &z[0], &x[0], &y[0], &z[0], count) );
+    tf.pushStaticTransformation(laser2Body);
+    BOOST_REQUIRE( deskewPoints(laser2BodyTr, base::Time::fromSeconds(1), base::Time::fromSeconds(2), 4, &x[0], &y[0], &z[0], &x[0], &y[0], &z[0], count) );
+    for(size_t i = 0; i < count; i++)
+        BOOST_CHECK_CLOSE( expected[3 * i + 1] + 100, y[i] + 100, 1e-9 );
+}
+
+BOOST_AUTO_TEST_CASE( covariance_propagation )
+{
+    transformer::NonAligningTransformer tf;
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+    Transformation &map2Laser = tf.registerTransformation("map", "laser");
+
+    TransformationType laser2Body = makeTransform("laser", "body", M_PI / 2, Eigen::Vector3d(1,0,0));
+    laser2Body.cov_position = Eigen::Matrix3d::Identity() * 1e-4;
+    laser2Body.cov_orientation = Eigen::Matrix3d::Identity() * 1e-2;
+    TransformationType body2Map = makeTransform("body", "map", M_PI / 4, Eigen::Vector3d(0,2,0));
+    body2Map.cov_position = Eigen::Vector3d(0.04, 0.01, 0.09).asDiagonal();
+    body2Map.cov_orientation = Eigen::Matrix3d::Identity() * 9e-4;
+    body2Map.time = base::Time::fromSeconds(1);
+    tf.pushStaticTransformation(laser2Body);
+    tf.pushDynamicTransformation(body2Map);
+
+    //reference: dense first order propagation through the adjoint of body2Map
+    Eigen::Isometry3d body2MapPose;
+    transformer::toPose(body2Map, body2MapPose);
+    Eigen::Matrix3d skew;
+    skew << 0, 0, 2,
+        0, 0, 0,
+        -2, 0, 0;
+    Eigen::MatrixXd adjoint(Eigen::MatrixXd::Zero(6, 6));
+    adjoint.block(0, 0, 3, 3) = body2MapPose.linear();
+    adjoint.block(0, 3, 3, 3) = skew * body2MapPose.linear();
+    adjoint.block(3, 3, 3, 3) = body2MapPose.linear();
+    Eigen::MatrixXd covBody2Map(Eigen::MatrixXd::Zero(6, 6)), covLaser2Body(Eigen::MatrixXd::Zero(6, 6));
+    covBody2Map.block(0, 0, 3, 3) = body2Map.cov_position;
+    covBody2Map.block(3, 3, 3, 3) = body2Map.cov_orientation;
+    covLaser2Body.block(0, 0, 3, 3) = laser2Body.cov_position;
+    covLaser2Body.block(3, 3, 3, 3) = laser2Body.cov_orientation;
+    Eigen::MatrixXd expected = covBody2Map + adjoint * covLaser2Body * adjoint.transpose();
+
+    Eigen::Isometry3d pose;
+    transformer::PoseCovariance covariance;
+    BOOST_REQUIRE( laser2Map.getWithCovariance(base::Time::fromSeconds(1), pose, covariance) );
+    BOOST_CHECK( pose.matrix().isApprox((Eigen::Affine3d(body2Map) * Eigen::Affine3d(laser2Body)).matrix()) );
+    BOOST_CHECK( covariance.isApprox(expected) );
+
+    //the inverse chain gives the inverse covariance
+    Eigen::Isometry3d inversePose;
+    transformer::PoseCovariance inverseCovariance;
+    BOOST_REQUIRE( map2Laser.getWithCovariance(base::Time::fromSeconds(1), inversePose, inverseCovariance) );
+    transformer::invertWithCovariance(pose, covariance);
+    BOOST_CHECK( inversePose.matrix().isApprox(pose.matrix()) );
+    BOOST_CHECK( inverseCovariance.isApprox(covariance) );
+
+    //batch queries give the same results as single ones
+    base::Time times[3] = { base::Time::fromSeconds(1), base::Time::fromSeconds(1), base::Time::fromSeconds(1) };
+    Eigen::Isometry3d poses[3];
+    transformer::PoseCovariance covariances[3];
+    bool valid[3];
+    BOOST_CHECK_EQUAL( 3, laser2Map.getWithCovariance(times, 3, poses, covariances, valid) );
+    for(int i = 0; i < 3; i++)
+        BOOST_CHECK( covariances[i].isApprox(expected) );
+
+    //the covariances of TransformationType are only set when enabled
+    TransformationType result;
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( !result.cov_position.isApprox(expected.block(0, 0, 3, 3)) );
+    laser2Map.setCovariancePropagation(true);
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1), result) );
+    BOOST_CHECK( result.cov_position.isApprox(expected.block(0, 0, 3, 3)) );
+    BOOST_CHECK( result.cov_orientation.isApprox(expected.block(3, 3, 3, 3)) );
+    BOOST_CHECK( result.getTransform().isApprox(Eigen::Affine3d(body2Map) * Eigen::Affine3d(laser2Body)) );
+
+    //interpolated covariances of a single element
+    transformer::NonAlignedDynamicTransformationElement element("body", "map");
+    TransformationType later = body2Map;
+    later.time = base::Time::fromSeconds(3);
+    later.position = Eigen::Vector3d(0,4,0);
+    later.cov_position = body2Map.cov_position * 3;
+    later.cov_orientation = body2Map.cov_orientation * 3;
+    element.setTransformation(body2Map.time, body2Map);
+    element.setTransformation(later.time, later);
+    BOOST_REQUIRE( element.getPoseWithCovariance(base::Time::fromSeconds(2), true, pose, covariance) );
+    BOOST_CHECK( pose.translation().isApprox(Eigen::Vector3d(0,3,0)) );
+    BOOST_CHECK( covariance.block(0, 0, 3, 3).isApprox(body2Map.cov_position * 2) );
+    BOOST_CHECK( covariance.block(3, 3, 3, 3).isApprox(body2Map.cov_orientation * 2) );
+    BOOST_CHECK( covariance.block(0, 3, 3, 3).isZero() );
+    BOOST_REQUIRE( element.getPoseWithCovariance(base::Time::fromSeconds(2), false, pose, covariance) );
+    BOOST_CHECK( pose.translation().isApprox(Eigen::Vector3d(0,2,0)) );
+    BOOST_CHECK( covariance.block(0, 0, 3, 3).isApprox(body2Map.cov_position) );
+    BOOST_CHECK( !element.getPoseWithCovariance(base::Time::fromSeconds(0.5), true, pose, covariance) );
+}
+
+TRANSFORMER_FRAME(GraphBase, "graph_base");
+TRANSFORMER_FRAME(GraphTorso, "graph_torso");
+TRANSFORMER_FRAME(GraphHead, "graph_head");
+TRANSFORMER_FRAME(GraphCamera, "graph_camera");
+TRANSFORMER_FRAME(GraphArm, "graph_arm");
+TRANSFORMER_FRAME(GraphGripper, "graph_gripper");
+
+typedef transformer::StaticFrameEdge<GraphTorso, GraphBase> TorsoToBase;
+typedef transformer::DynamicFrameEdge<GraphHead, GraphTorso> HeadToTorso;
+typedef transformer::StaticFrameEdge<GraphCamera, GraphHead> CameraToHead;
+typedef transformer::DynamicFrameEdge<GraphArm, GraphTorso> ArmToTorso;
+typedef transformer::StaticFrameEdge<GraphGripper, GraphArm> GripperToArm;
+typedef transformer::FrameGraph< boost::mpl::vector<TorsoToBase, HeadToTorso, CameraToHead, ArmToTorso, GripperToArm> > RobotGraph;
+
+//graphs rejected at compile time by FrameGraph
+typedef boost::mpl::vector<TorsoToBase, transformer::StaticFrameEdge<GraphBase, GraphHead>, HeadToTorso> CyclicEdges;
+typedef boost::mpl::vector<TorsoToBase, HeadToTorso, transformer::StaticFrameEdge<GraphHead, GraphBase> > SharedSourceEdges;
+BOOST_STATIC_ASSERT(( !transformer::frame_graph::NoEdge<CyclicEdges, transformer::frame_graph::InCycle<CyclicEdges> >::value ));
+BOOST_STATIC_ASSERT(( transformer::frame_graph::NoEdge<CyclicEdges, transformer::frame_graph::SharesSource<CyclicEdges> >::value ));
+BOOST_STATIC_ASSERT(( !transformer::frame_graph::NoEdge<SharedSourceEdges, transformer::frame_graph::SharesSource<SharedSourceEdges> >::value ));
+BOOST_STATIC_ASSERT(( transformer::frame_graph::NoEdge<RobotGraph::Edges, transformer::frame_graph::InCycle<RobotGraph::Edges> >::value ));
+
+BOOST_AUTO_TEST_CASE( compile_time_frame_graph )
+{
+    RobotGraph graph;
+    Eigen::Affine3d torso2Base(makeTransform("graph_torso", "graph_base", 0, Eigen::Vector3d(0,0,1)));
+    Eigen::Affine3d head2Torso(makeTransform("graph_head", "graph_torso", M_PI / 4, Eigen::Vector3d(0,0,0.5)));
+    Eigen::Affine3d camera2Head(makeTransform("graph_camera", "graph_head", 0, Eigen::Vector3d(0.1,0,0)));
+    Eigen::Affine3d arm2Torso(makeTransform("graph_arm", "graph_torso", -M_PI / 2, Eigen::Vector3d(0,0.3,0.2)));
+    Eigen::Affine3d gripper2Arm(makeTransform("graph_gripper", "graph_arm", 0, Eigen::Vector3d(0.6,0,0)));
+    graph.set<TorsoToBase>(Eigen::Isometry3d(torso2Base.matrix()));
+    graph.set<HeadToTorso>(Eigen::Isometry3d(head2Torso.matrix()));
+    graph.set<CameraToHead>(Eigen::Isometry3d(camera2Head.matrix()));
+    graph.set<ArmToTorso>(Eigen::Isometry3d(arm2Torso.matrix()));
+    graph.set<GripperToArm>(Eigen::Isometry3d(gripper2Arm.matrix()));
+
+    Eigen::Isometry3d result;
+    graph.get<GraphCamera, GraphBase>(result);
+    BOOST_CHECK( result.matrix().isApprox((torso2Base * head2Torso * camera2Head).matrix()) );
+    graph.get<GraphCamera, GraphGripper>(result);
+    Eigen::Affine3d camera2Gripper = (arm2Torso * gripper2Arm).inverse() * head2Torso * camera2Head;
+    BOOST_CHECK( result.matrix().isApprox(camera2Gripper.matrix()) );
+    graph.get<GraphBase, GraphHead>(result);
+    BOOST_CHECK( result.matrix().isApprox((torso2Base * head2Torso).inverse().matrix()) );
+    graph.get<GraphArm, GraphArm>(result);
+    BOOST_CHECK( result.matrix().isIdentity() );
+
+    //the same chains through the runtime transformer
+    transformer::NonAligningTransformer tf;
+    Transformation &camera2GripperTf = tf.registerTransformation("graph_camera", "graph_gripper");
+    Transformation &torso2BaseTf = tf.registerTransformation("graph_torso", "graph_base");
+    transformer::FrameGraphBridge<RobotGraph> bridge(graph, tf);
+
+    Eigen::Affine3d tfResult;
+    BOOST_REQUIRE( camera2GripperTf.get(base::Time::fromSeconds(1), tfResult) );
+    BOOST_CHECK( tfResult.isApprox(camera2Gripper) );
+    BOOST_REQUIRE( torso2BaseTf.get(base::Time::fromSeconds(1), tfResult) );
+    BOOST_CHECK( tfResult.isApprox(torso2Base) );
+
+    //changes of the graph are seen by the transformer after an update
+    unsigned version = camera2GripperTf.getVersion();
+    head2Torso = makeTransform("graph_head", "graph_torso", -M_PI / 4, Eigen::Vector3d(0,0,0.5));
+    graph.set<HeadToTorso>(Eigen::Isometry3d(head2Torso.matrix()));
+    torso2Base = makeTransform("graph_torso", "graph_base", 0, Eigen::Vector3d(0,0,2));
+    graph.set<TorsoToBase>(Eigen::Isometry3d(torso2Base.matrix()));
+    bridge.update(base::Time::fromSeconds(2));
+    BOOST_CHECK( camera2GripperTf.hasChangedSince(version) );
+
+    camera2Gripper = (arm2Torso * gripper2Arm).inverse() * head2Torso * camera2Head;
+    BOOST_REQUIRE( camera2GripperTf.get(base::Time::fromSeconds(2), tfResult) );
+    BOOST_CHECK( tfResult.isApprox(camera2Gripper) );
+    BOOST_REQUIRE( torso2BaseTf.get(base::Time::fromSeconds(2), tfResult) );
+    BOOST_CHECK( tfResult.isApprox(torso2Base) );
+}
+
+bool gotJointResult;
+Eigen::Affine3d jointResult;
+
+void joint_callback(const base::Time &ts, const base::samples::LaserScan &value, const Transformation &t)
+{
+    gotJointResult = t.get(ts, jointResult, true);
+}
+
+base::samples::Joints makeJoints(const base::Time &time, double pan, double tilt, double slide)
+{
+    base::samples::Joints joints;
+    joints.time = time;
+    joints.names.push_back("tilt");
+    joints.names.push_back("pan");
+    joints.names.push_back("slide");
+    joints.elements.push_back(base::JointState::Position(tilt));
+    joints.elements.push_back(base::JointState::Position(pan));
+    joints.elements.push_back(base::JointState::Position(slide));
+    return joints;
+}
+
+BOOST_AUTO_TEST_CASE( joint_state_elements )
+{
+    Eigen::Isometry3d panOrigin(Eigen::Isometry3d::Identity());
+    panOrigin.translation() = Eigen::Vector3d(0, 0, 0.5);
+    Eigen::Isometry3d tiltOrigin(Eigen::Isometry3d::Identity());
+    tiltOrigin.translation() = Eigen::Vector3d(0.1, 0, 0);
+    std::vector<transformer::JointDescription> joints;
+    joints.push_back(transformer::JointDescription("pan", transformer::JointDescription::REVOLUTE, "pan_link", "pt_base", Eigen::Vector3d::UnitZ(), panOrigin));
+    joints.push_back(transformer::JointDescription("tilt", transformer::JointDescription::REVOLUTE, "tilt_link", "pan_link", Eigen::Vector3d::UnitY(), tiltOrigin));
+    joints.push_back(transformer::JointDescription("slide", transformer::JointDescription::PRISMATIC, "slider", "pt_base", Eigen::Vector3d::UnitX()));
+
+    transformer::Transformer tf;
+    Transformation &tilt2Base = tf.registerTransformation("tilt_link", "pt_base");
+    int ls_idx = tf.registerDataStreamWithTransform<base::samples::LaserScan>(base::Time::fromSeconds(1), tilt2Base, &joint_callback);
+    int joint_idx = tf.registerJointStream(joints);
+
+    //a single stream carries all joints
+    tf.pushJointState(joint_idx, makeJoints(base::Time::fromSeconds(1), 0, 0, 0));
+    tf.pushJointState(joint_idx, makeJoints(base::Time::fromSeconds(2), M_PI / 2, -0.4, 1));
+    base::samples::LaserScan ls;
+    tf.pushData(ls_idx, base::Time::fromSeconds(1.5), ls);
+    gotJointResult = false;
+    while(tf.step())
+        ;
+
+    //interpolated in joint space, i.e. pan at 45 degrees
+    BOOST_REQUIRE( gotJointResult );
+    Eigen::Affine3d expected = Eigen::Affine3d(panOrigin) * Eigen::AngleAxisd(M_PI / 4, Eigen::Vector3d::UnitZ()) *
+        Eigen::Affine3d(tiltOrigin) * Eigen::AngleAxisd(-0.2, Eigen::Vector3d::UnitY());
+    BOOST_CHECK( jointResult.isApprox(expected) );
+
+    //the non aligning transformer takes the samples directly
+    transformer::NonAligningTransformer nonAligning;
+    Transformation &slider2Tilt = nonAligning.registerTransformation("slider", "tilt_link");
+    int nonAligningIdx = nonAligning.registerJointStream(joints);
+    Eigen::Affine3d result;
+    BOOST_CHECK( !slider2Tilt.get(base::Time::fromSeconds(1), result) );
+    nonAligning.pushJointState(nonAligningIdx, makeJoints(base::Time::fromSeconds(1), M_PI / 2, -0.4, 2));
+    BOOST_REQUIRE( slider2Tilt.get(base::Time::fromSeconds(1), result) );
+    expected = (Eigen::Affine3d(panOrigin) * Eigen::AngleAxisd(M_PI / 2, Eigen::Vector3d::UnitZ()) *
+        Eigen::Affine3d(tiltOrigin) * Eigen::AngleAxisd(-0.4, Eigen::Vector3d::UnitY())).inverse() *
+        Eigen::Translation3d(2, 0, 0);
+    BOOST_CHECK( result.isApprox(expected) );
+
+    //joints missing in a sample are unavailable
+    base::samples::Joints panOnly;
+    panOnly.time = base::Time::fromSeconds(2);
+    panOnly.names.push_back("pan");
+    panOnly.elements.push_back(base::JointState::Position(0));
+    nonAligning.pushJointState(nonAligningIdx, panOnly);
+    BOOST_CHECK( !slider2Tilt.get(base::Time::fromSeconds(2), result) );
+
+    //queries between older samples are interpolated from the history
+    transformer::NonAligningTransformer history;
+    Transformation &pan2Base = history.registerTransformation("pan_link", "pt_base");
+    Transformation &slider2Base = history.registerTransformation("slider", "pt_base");
+    int historyIdx = history.registerJointStream(joints);
+    history.pushJointState(historyIdx, makeJoints(base::Time::fromSeconds(1), 0, 0, 2));
+    history.pushJointState(historyIdx, makeJoints(base::Time::fromSeconds(2), M_PI / 2, 0, 6));
+    history.pushJointState(historyIdx, makeJoints(base::Time::fromSeconds(3), M_PI, 0, 10));
+    BOOST_REQUIRE( pan2Base.get(base::Time::fromSeconds(1.25), result, true) );
+    expected = Eigen::Affine3d(panOrigin) * Eigen::AngleAxisd(M_PI / 8, Eigen::Vector3d::UnitZ());
+    BOOST_CHECK( result.isApprox(expected) );
+    BOOST_REQUIRE( slider2Base.get(base::Time::fromSeconds(2.8), result, true) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(9.2, 0, 0)) );
+    BOOST_CHECK( !slider2Base.get(base::Time::fromSeconds(0.5), result, true) );
+    BOOST_CHECK( !slider2Base.get(base::Time::fromSeconds(3.5), result, true) );
+    //without interpolation, the sample at or before the query is used
+    BOOST_REQUIRE( slider2Base.get(base::Time::fromSeconds(2.8), result) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(6, 0, 0)) );
+    BOOST_CHECK( !slider2Base.get(base::Time::fromSeconds(0.5), result) );
+    base::Time sampleTime;
+    BOOST_REQUIRE( slider2Base.getSampleTimeAfter(base::Time::fromSeconds(1), sampleTime) );
+    BOOST_CHECK_EQUAL( base::Time::fromSeconds(2), sampleTime );
+
+    //the history is bounded
+    history.setHistorySize(2);
+    BOOST_CHECK( !slider2Base.get(base::Time::fromSeconds(1.25), result, true) );
+    BOOST_REQUIRE( slider2Base.get(base::Time::fromSeconds(2.25), result, true) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(7, 0, 0)) );
+
+    //revolute joints are interpolated the short way around
+    history.pushJointState(historyIdx, makeJoints(base::Time::fromSeconds(4), 3, 0, 0));
+    history.pushJointState(historyIdx, makeJoints(base::Time::fromSeconds(5), -3, 0, 0));
+    BOOST_REQUIRE( pan2Base.get(base::Time::fromSeconds(4.25), result, true) );
+    expected = Eigen::Affine3d(panOrigin) * Eigen::AngleAxisd(3 + 0.25 * (2 * M_PI - 6), Eigen::Vector3d::UnitZ());
+    BOOST_CHECK( result.isApprox(expected) );
+}
+
+BOOST_AUTO_TEST_CASE( pose_history )
+{
+    transformer::PoseHistory history(4);
+    size_t index;
+    BOOST_CHECK( !history.find(base::Time::fromSeconds(1), index) );
+    for(int i = 1; i <= 6; i++)
+    {
+        TransformationType sample = makeTransform("a", "b", 0, Eigen::Vector3d(i,0,0));
+        BOOST_CHECK( history.push(base::Time::fromSeconds(i), sample) );
+    }
+    //older samples are rejected, the oldest ones got dropped
+    BOOST_CHECK( !history.push(base::Time::fromSeconds(5.5), makeTransform("a", "b", 0, Eigen::Vector3d::Zero())) );
+    BOOST_CHECK_EQUAL( 4, history.size() );
+    BOOST_CHECK_EQUAL( base::Time::fromSeconds(3), history.getOldestTime() );
+    BOOST_CHECK_EQUAL( base::Time::fromSeconds(6), history.getLatestTime() );
+
+    BOOST_CHECK( !history.find(base::Time::fromSeconds(2.9), index) );
+    BOOST_REQUIRE( history.find(base::Time::fromSeconds(4.5), index) );
+    BOOST_CHECK_EQUAL( 4, history.getPosition(index).x() );
+    BOOST_REQUIRE( history.find(base::Time::fromSeconds(5), index) );
+    BOOST_CHECK_EQUAL( 5, history.getPosition(index).x() );
+    BOOST_REQUIRE( history.find(base::Time::fromSeconds(3), index) );
+    BOOST_CHECK_EQUAL( 3, history.getPosition(index).x() );
+    BOOST_REQUIRE( history.find(base::Time::fromSeconds(100), index) );
+    BOOST_CHECK_EQUAL( 6, history.getPosition(index).x() );
+
+    history.setCapacity(2);
+    BOOST_CHECK_EQUAL( base::Time::fromSeconds(5), history.getOldestTime() );
+    BOOST_REQUIRE( history.find(base::Time::fromSeconds(5.5), index) );
+    BOOST_CHECK_EQUAL( 5, history.getPosition(index).x() );
+}
+
+BOOST_AUTO_TEST_CASE( dynamic_history_queries )
+{
+    transformer::Transformer tf;
+    Transformation &body2Map = tf.registerTransformation("body", "map");
+    for(int i = 1; i <= 5; i++)
+    {
+        TransformationType sample = makeTransform("body", "map", 0, Eigen::Vector3d(i,0,0));
+        sample.time = base::Time::fromSeconds(i);
+        tf.pushDynamicTransformation(sample);
+    }
+    while(tf.step())
+        ;
+
+    //queries in the past are answered from the history
+    Eigen::Affine3d result;
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(2.5), result, true) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(2.5,0,0)) );
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(1.25), result, true) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(1.25,0,0)) );
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(3.7), result) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(3,0,0)) );
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(6), result) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(5,0,0)) );
+    BOOST_CHECK( !body2Map.get(base::Time::fromSeconds(6), result, true) );
+    BOOST_CHECK( !body2Map.get(base::Time::fromSeconds(0.5), result) );
+
+    base::Time times[3] = { base::Time::fromSeconds(1.25), base::Time::fromSeconds(3.5), base::Time::fromSeconds(4.8) };
+    Eigen::Isometry3d poses[3];
+    bool valid[3];
+    BOOST_CHECK_EQUAL( 3, body2Map.get(times, 3, poses, valid, true) );
+    for(int i = 0; i < 3; i++)
+        BOOST_CHECK( poses[i].translation().isApprox(Eigen::Vector3d(times[i].toSeconds(),0,0)) );
+
+    //the history is bounded
+    tf.setHistorySize(2);
+    BOOST_CHECK( !body2Map.get(base::Time::fromSeconds(3.5), result, true) );
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(4.5), result, true) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(4.5,0,0)) );
+}
+
+BOOST_AUTO_TEST_CASE( non_aligned_history )
+{
+    transformer::NonAligningTransformer tf;
+    Transformation &body2Map = tf.registerTransformation("body", "map");
+    const int order[4] = { 1, 2, 4, 3 };
+    for(int i = 0; i < 4; i++)
+    {
+        TransformationType sample = makeTransform("body", "map", 0, Eigen::Vector3d(order[i],0,0));
+        sample.time = base::Time::fromSeconds(order[i]);
+        sample.cov_position = Eigen::Matrix3d::Identity() * order[i];
+        sample.cov_orientation = Eigen::Matrix3d::Identity() * order[i];
+        tf.pushDynamicTransformation(sample);
+    }
+
+    //the late sample is merged in time order
+    Eigen::Affine3d result;
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(3.5), result, true) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(3.5,0,0)) );
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(2.5), result, true) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(2.5,0,0)) );
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(3.25), result, true) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(3.25,0,0)) );
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(1.8), result, true) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(1.8,0,0)) );
+
+    //the covariances are interpolated with the same weights
+    std::vector<TransformationType> chain;
+    BOOST_REQUIRE( body2Map.getChain(base::Time::fromSeconds(3.25), chain, true) );
+    BOOST_REQUIRE_EQUAL( 1, chain.size() );
+    BOOST_CHECK( chain[0].position.isApprox(Eigen::Vector3d(3.25,0,0)) );
+    BOOST_CHECK( chain[0].cov_position.isApprox(Eigen::Matrix3d::Identity() * 3.25) );
+    BOOST_CHECK( chain[0].cov_orientation.isApprox(Eigen::Matrix3d::Identity() * 3.25) );
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(3.2), result) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(3,0,0)) );
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(5), result) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(4,0,0)) );
+    BOOST_CHECK( !body2Map.get(base::Time::fromSeconds(5), result, true) );
+    BOOST_CHECK( !body2Map.get(base::Time::fromSeconds(0.5), result) );
+
+    //the history is bounded, samples older than all retained ones are dropped
+    tf.setHistorySize(2);
+    BOOST_CHECK( !body2Map.get(base::Time::fromSeconds(2.5), result, true) );
+    TransformationType late = makeTransform("body", "map", 0, Eigen::Vector3d(10,0,0));
+    late.time = base::Time::fromSeconds(1.5);
+    tf.pushDynamicTransformation(late);
+    BOOST_CHECK( !body2Map.get(base::Time::fromSeconds(1.5), result) );
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(3.5), result, true) );
+    BOOST_CHECK( result.translation().isApprox(Eigen::Vector3d(3.5,0,0)) );
+}
+
+BOOST_AUTO_TEST_CASE( bounded_extrapolation )
+{
+    transformer::NonAligningTransformer tf;
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+    Transformation &map2Laser = tf.registerTransformation("map", "laser");
+    tf.pushStaticTransformation(makeTransform("laser", "body", 0, Eigen::Vector3d(1,0,0)));
+    TransformationType body2Map = makeTransform("body", "map", 0, Eigen::Vector3d(0,0,0));
+    body2Map.time = base::Time::fromSeconds(1);
+    tf.pushDynamicTransformation(body2Map);
+    body2Map = makeTransform("body", "map", 0.1, Eigen::Vector3d(1,0,0));
+    body2Map.time = base::Time::fromSeconds(2);
+    tf.pushDynamicTransformation(body2Map);
+
+    base::Time atTime = base::Time::fromSeconds(2.5);
+    Eigen::Isometry3d expected(Eigen::AngleAxisd(0.15, Eigen::Vector3d::UnitZ()));
+    expected.translation() = Eigen::Vector3d(1.5,0,0);
+    expected = expected * Eigen::Translation3d(1,0,0);
+
+    Eigen::Affine3d result;
+    BOOST_CHECK( !laser2Map.get(atTime, result, true) );
+    BOOST_CHECK_EQUAL( 1, laser2Map.getStatus().failed_interpolation_impossible );
+
+    //constant velocity from the two latest samples
+    laser2Map.setExtrapolation(transformer::ExtrapolationPolicy(transformer::ExtrapolationPolicy::FROM_SAMPLES, base::Time::fromSeconds(0.5)));
+    map2Laser.setExtrapolation(laser2Map.getExtrapolation());
+    BOOST_REQUIRE( laser2Map.get(atTime, result, true) );
+    BOOST_CHECK( result.matrix().isApprox(expected.matrix()) );
+    BOOST_REQUIRE( map2Laser.get(atTime, result, true) );
+    BOOST_CHECK( result.matrix().isApprox(expected.inverse().matrix()) );
+    BOOST_CHECK( !laser2Map.get(base::Time::fromSeconds(2.6), result, true) );
+    //queries that do not need it are not extrapolated
+    BOOST_REQUIRE( laser2Map.get(base::Time::fromSeconds(1.5), result, true) );
+
+    base::Time times[2] = { base::Time::fromSeconds(1.5), atTime };
+    Eigen::Isometry3d poses[2];
+    bool valid[2];
+    BOOST_CHECK_EQUAL( 2, laser2Map.get(times, 2, poses, valid, true) );
+    BOOST_CHECK( poses[1].matrix().isApprox(expected.matrix()) );
+
+    TransformationStatus status = laser2Map.getStatus();
+    BOOST_CHECK_EQUAL( 4, status.generated_transformations );
+    BOOST_CHECK_EQUAL( 2, status.extrapolated_transformations );
+    BOOST_CHECK_EQUAL( 2, status.failed_interpolation_impossible );
+
+    //constant velocity from the velocities of the latest sample
+    laser2Map.setExtrapolation(transformer::ExtrapolationPolicy(transformer::ExtrapolationPolicy::FROM_VELOCITIES, base::Time::fromSeconds(0.5)));
+    BOOST_CHECK( !laser2Map.get(atTime, result, true) );
+    body2Map.time = base::Time::fromSeconds(2);
+    body2Map.velocity = Eigen::Vector3d(1,0,0);
+    body2Map.angular_velocity = Eigen::Vector3d(0,0,0.1);
+    tf.pushDynamicTransformation(body2Map);
+    BOOST_REQUIRE( laser2Map.get(atTime, result, true) );
+    BOOST_CHECK( result.matrix().isApprox(expected.matrix()) );
+}
+
+BOOST_AUTO_TEST_CASE( compressed_pose_archive )
+{
+    transformer::NonAligningTransformer tf;
+    Transformation &body2Map = tf.registerTransformation("body", "map");
+    tf.setHistorySize(10);
+    tf.setHistoryArchive(base::Time::fromSeconds(20), 1e-3, 1e-3);
+
+    //30 seconds at 200Hz, going straight and then along a circle
+    std::vector<TransformationType> samples;
+    for(int i = 1; i <= 6000; i++)
+    {
+        double t = i / 200.0;
+        double angle = t < 15 ? 0 : 0.5 * (t - 15);
+        Eigen::Vector3d position(t < 15 ? Eigen::Vector3d(t,0,0) : Eigen::Vector3d(15 + 2 * sin(angle), 2 - 2 * cos(angle), 0));
+        TransformationType sample = makeTransform("body", "map", angle, position);
+        sample.time = base::Time::fromSeconds(t);
+        samples.push_back(sample);
+        tf.pushDynamicTransformation(sample);
+    }
+
+    //the original samples are within the tolerances
+    Eigen::Affine3d result;
+    for(size_t i = 2000; i < samples.size(); i += 7)
+    {
+        BOOST_REQUIRE( body2Map.get(samples[i].time, result, true) );
+        BOOST_CHECK_SMALL( (result.translation() - samples[i].position).norm(), 1e-3 + 1e-9 );
+        BOOST_CHECK_SMALL( Eigen::Quaterniond(result.linear()).angularDistance(samples[i].orientation), 1e-3 + 1e-9 );
+    }
+    //between the archive and the history
+    BOOST_REQUIRE( body2Map.get(base::Time::fromSeconds(29.9525), result) );
+    BOOST_CHECK_SMALL( (result.translation() - (samples[5989].position + samples[5990].position) / 2).norm(), 1e-3 );
+    //no jump where the history hands over to the archive
+    Eigen::Affine3d before, after;
+    BOOST_REQUIRE( body2Map.get(samples[5990].time - base::Time::fromMicroseconds(1), before, true) );
+    BOOST_REQUIRE( body2Map.get(samples[5990].time, after, true) );
+    BOOST_CHECK_SMALL( (before.translation() - after.translation()).norm(), 1e-4 );
+
+    //the archive does not keep covariances
+    Eigen::Isometry3d pose;
+    transformer::PoseCovariance covariance;
+    BOOST_CHECK( !body2Map.getWithCovariance(base::Time::fromSeconds(20), pose, covariance, true) );
+    BOOST_CHECK( body2Map.getWithCovariance(base::Time::fromSeconds(29.99), pose, covariance, true) );
+    std::vector<TransformationType> chain;
+    BOOST_REQUIRE( body2Map.getChain(base::Time::fromSeconds(20), chain, true) );
+    BOOST_CHECK_SMALL( (chain[0].position - samples[3999].position).norm(), 1e-3 + 1e-9 );
+    BOOST_CHECK( chain[0].cov_position(0, 0) != chain[0].cov_position(0, 0) );
+    BOOST_CHECK( chain[0].cov_orientation(0, 0) != chain[0].cov_orientation(0, 0) );
+
+    //older samples are dropped
+    BOOST_CHECK( !body2Map.get(base::Time::fromSeconds(9), result, true) );
+
+    //the archive keeps a fraction of the samples it covers
+    transformer::PoseArchive archive;
+    archive.configure(base::Time::fromSeconds(20), 1e-3, 1e-3);
+    for(size_t i = 0; i < samples.size(); i++)
+        archive.push(samples[i].time, samples[i].orientation, samples[i].position);
+    BOOST_CHECK( archive.getOldestTime() <= base::Time::fromSeconds(9.995) );
+    BOOST_CHECK( archive.getStoredCount() < 400 );
+}
+
+BOOST_AUTO_TEST_CASE( sample_time_iteration )
+{
+    transformer::NonAligningTransformer tf;
+    Transformation &laser2Map = tf.registerTransformation("laser", "map");
+    Transformation &map2Laser = tf.registerTransformation("map", "laser");
+    tf.pushStaticTransformation(makeTransform("laser", "body", 0.2, Eigen::Vector3d(1,0,0)));
+    for(int i = 1; i <= 4; i++)
+    {
+        TransformationType body2Odometry = makeTransform("body", "odometry", 0.1 * i, Eigen::Vector3d(i,0,0));
+        body2Odometry.time = base::Time::fromSeconds(i);
+        tf.pushDynamicTransformation(body2Odometry);
+    }
+    for(int i = 1; i <= 3; i++)
+    {
+        TransformationType odometry2Map = makeTransform("odometry", "map", 0, Eigen::Vector3d(0,i,0));
+        odometry2Map.time = base::Time::fromSeconds(i + 0.5);
+        tf.pushDynamicTransformation(odometry2Map);
+    }
+
+    //the time of the first sample can not be interpolated and is skipped
+    const double expectedTimes[5] = { 1.5, 2, 2.5, 3, 3.5 };
+    transformer::TransformationSampleIterator it(laser2Map, base::Time::fromSeconds(1), base::Time::fromSeconds(3.5));
+    Eigen::Affine3d expected;
+    for(int i = 0; i < 5; i++)
+    {
+        BOOST_REQUIRE( it.next() );
+        BOOST_CHECK_EQUAL( base::Time::fromSeconds(expectedTimes[i]), it.getTime() );
+        BOOST_REQUIRE( laser2Map.get(it.getTime(), expected, true) );
+        BOOST_CHECK( it.getPose().matrix().isApprox(expected.matrix()) );
+    }
+    BOOST_CHECK( !it.next() );
+    BOOST_CHECK( !it.next() );
+
+    int count = 0;
+    transformer::TransformationSampleIterator inverse(map2Laser, base::Time::fromSeconds(2), base::Time::fromSeconds(3));
+    while(inverse.next())
+    {
+        BOOST_CHECK_EQUAL( base::Time::fromSeconds(expectedTimes[count + 1]), inverse.getTime() );
+        count++;
+    }
+    BOOST_CHECK_EQUAL( 3, count );
+}